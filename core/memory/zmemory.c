@@ -1,6 +1,7 @@
 #include "zmemory.h"
 #include "logger.h"
 #include "zmutex.h"
+#include "platform.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -46,6 +47,45 @@ void zmemory_free(void* block, u64 size) {
     }
 }
 
+void* zmemory_allocate_pages(u64 size) {
+    void* temp = platform_allocate_pages(size);
+    if (temp) {
+        zmutex_lock(&state.mutex);
+        state.allocated_memory += size;
+        zmutex_unlock(&state.mutex);
+    }
+    return temp;
+}
+
+void* zmemory_allocate_pages_aligned(u64 size, u64 alignment) {
+    void* temp = platform_allocate_pages_aligned(size, alignment);
+    if (temp) {
+        zmutex_lock(&state.mutex);
+        state.allocated_memory += size;
+        zmutex_unlock(&state.mutex);
+    }
+    return temp;
+}
+
+void zmemory_free_pages(void* block, u64 size) {
+    if (block) {
+        platform_free_pages(block, size);
+        zmutex_lock(&state.mutex);
+        state.allocated_memory -= size;
+        zmutex_unlock(&state.mutex);
+    }
+}
+
+void* zmemory_reallocate_pages(void* block, u64 old_size, u64 new_size) {
+    void* temp = platform_reallocate_pages(block, old_size, new_size);
+    if (temp) {
+        zmutex_lock(&state.mutex);
+        state.allocated_memory = state.allocated_memory - old_size + new_size;
+        zmutex_unlock(&state.mutex);
+    }
+    return temp;
+}
+
 void* zmemory_set(void* block, i32 value, u64 size) {
     return memset(block, value, size);
 }
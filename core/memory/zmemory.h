@@ -11,6 +11,17 @@ void* zmemory_allocate(u64 size);
 
 void zmemory_free(void* block, u64 size);
 
+// page aligned and zeroed, pages stay non resident until first touched
+void* zmemory_allocate_pages(u64 size);
+
+// alignment must be a power of two multiple of the page size
+void* zmemory_allocate_pages_aligned(u64 size, u64 alignment);
+
+void zmemory_free_pages(void* block, u64 size);
+
+// grows or shrinks pages from zmemory_allocate_pages without copying where the platform allows it
+void* zmemory_reallocate_pages(void* block, u64 old_size, u64 new_size);
+
 void* zmemory_set(void* block, i32 value, u64 size);
 
 void* zmemory_set_zero(void* block, u64 size);
@@ -7,4 +7,18 @@ void platform_sleep(u64 ms);
 
 f64 platform_time();
 
+u64 platform_page_size();
+
+// zeroed, page aligned and not resident until first touched
+void* platform_allocate_pages(u64 size);
+
+// alignment must be a power of two multiple of the page size
+void* platform_allocate_pages_aligned(u64 size, u64 alignment);
+
+void platform_free_pages(void* block, u64 size);
+
+// resizes a mapping from platform_allocate_pages, the contents up to the smaller size are kept,
+// the block may move, 0 on failure with block left as it was
+void* platform_reallocate_pages(void* block, u64 old_size, u64 new_size);
+
 #endif
\ No newline at end of file
@@ -1,3 +1,5 @@
+// mremap
+#define _GNU_SOURCE
 #include "platform.h"
 
 #ifdef LINUX
@@ -6,6 +8,7 @@
 #    include <stdlib.h>
 #    include <time.h>
 #    include <semaphore.h>
+#    include <sys/mman.h>
 #    include "zmemory.h"
 #    include "logger.h"
 #    include "zthread.h"
@@ -13,6 +16,33 @@
 #    include "zsemaphore.h"
 // use - lrt(real time library) while linking
 
+typedef struct zthread_start_info {
+    PFN_zthread_start func;
+    void* params;
+} zthread_start_info;
+
+typedef struct zthread_exit_callback {
+    PFN_zthread_exit func;
+    void* params;
+} zthread_exit_callback;
+
+static _Thread_local zthread_exit_callback exit_callbacks[ZTHREAD_MAX_EXIT_CALLBACKS];
+static _Thread_local u32 exit_callback_count;
+
+void* zthread_start(void* arg) {
+    zthread_start_info info = *(zthread_start_info*)arg;
+    free(arg);
+
+    void* result = info.func(info.params);
+
+    // last registered runs first
+    while (exit_callback_count) {
+        exit_callback_count -= 1;
+        exit_callbacks[exit_callback_count].func(exit_callbacks[exit_callback_count].params);
+    }
+    return result;
+}
+
 void platform_sleep(u64 ms) {
     usleep(ms);
 }
@@ -23,14 +53,70 @@ f64 platform_time() {
     return curr_time.tv_sec + curr_time.tv_nsec / 1e9;
 }
 
+u64 platform_page_size() {
+    return (u64)sysconf(_SC_PAGESIZE);
+}
+
+void* platform_allocate_pages(u64 size) {
+    void* block = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED) {
+        LOGE("platform_allocate_pages : mmap failed");
+        return 0;
+    }
+    return block;
+}
+
+void* platform_allocate_pages_aligned(u64 size, u64 alignment) {
+    // over map by the alignment and give back the unaligned head and the tail
+    u8* block = mmap(0, size + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED) {
+        LOGE("platform_allocate_pages_aligned : mmap failed");
+        return 0;
+    }
+    u8* aligned = (u8*)(((u64)block + alignment - 1) & ~(alignment - 1));
+    u64 head = aligned - block;
+    if (head) {
+        munmap(block, head);
+    }
+    if (alignment - head) {
+        munmap(aligned + size, alignment - head);
+    }
+    return aligned;
+}
+
+void platform_free_pages(void* block, u64 size) {
+    if (munmap(block, size) != 0) {
+        LOGE("platform_free_pages : munmap failed");
+    }
+}
+
+void* platform_reallocate_pages(void* block, u64 old_size, u64 new_size) {
+    // the kernel moves the page table entries, the data itself is never copied
+    void* moved = mremap(block, old_size, new_size, MREMAP_MAYMOVE);
+    if (moved == MAP_FAILED) {
+        LOGE("platform_reallocate_pages : mremap failed");
+        return 0;
+    }
+    return moved;
+}
+
 bool zthread_create(PFN_zthread_start func, void* params, zthread* out_thread) {
     if (!func || !out_thread) {
         LOGE("zthread_create : invalid params");
         return false;
     }
 
-    if (pthread_create((pthread_t*)out_thread, 0, func, params) != 0) {
+    zthread_start_info* info = malloc(sizeof(zthread_start_info));
+    if (info == 0) {
+        LOGE("zthread_create : failed to allocate memory");
+        return false;
+    }
+    info->func = func;
+    info->params = params;
+
+    if (pthread_create((pthread_t*)out_thread, 0, zthread_start, info) != 0) {
         LOGE("zthread_create : failed to create zthread");
+        free(info);
         return false;
     }
     return true;
@@ -73,6 +159,21 @@ bool zthread_wait_on_all(zthread* threads, u64 count) {
     return true;
 }
 
+bool zthread_register_exit_callback(PFN_zthread_exit func, void* params) {
+    if (!func) {
+        LOGE("zthread_register_exit_callback : invalid params");
+        return false;
+    }
+    if (exit_callback_count == ZTHREAD_MAX_EXIT_CALLBACKS) {
+        LOGW("zthread_register_exit_callback : too many callbacks");
+        return false;
+    }
+    exit_callbacks[exit_callback_count].func = func;
+    exit_callbacks[exit_callback_count].params = params;
+    exit_callback_count += 1;
+    return true;
+}
+
 bool zmutex_create(zmutex* out_mutex) {
     if (!out_mutex) {
         LOGE("zmutex_create : invalid params");
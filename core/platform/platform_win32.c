@@ -8,6 +8,33 @@
 #    include "zmutex.h"
 #    include "zsemaphore.h"
 
+typedef struct zthread_start_info {
+    PFN_zthread_start func;
+    void* params;
+} zthread_start_info;
+
+typedef struct zthread_exit_callback {
+    PFN_zthread_exit func;
+    void* params;
+} zthread_exit_callback;
+
+static _Thread_local zthread_exit_callback exit_callbacks[ZTHREAD_MAX_EXIT_CALLBACKS];
+static _Thread_local u32 exit_callback_count;
+
+DWORD WINAPI zthread_start(LPVOID arg) {
+    zthread_start_info info = *(zthread_start_info*)arg;
+    HeapFree(GetProcessHeap(), 0, arg);
+
+    u32 result = info.func(info.params);
+
+    // last registered runs first
+    while (exit_callback_count) {
+        exit_callback_count -= 1;
+        exit_callbacks[exit_callback_count].func(exit_callbacks[exit_callback_count].params);
+    }
+    return result;
+}
+
 void platform_sleep(u64 ms) {
     Sleep(ms);
 }
@@ -20,14 +47,74 @@ f64 platform_time() {
     return curr_ticks.QuadPart / (f64)ticks_per_sec.QuadPart;
 }
 
+u64 platform_page_size() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+}
+
+void* platform_allocate_pages(u64 size) {
+    void* block = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!block) {
+        LOGE("platform_allocate_pages : VirtualAlloc failed");
+    }
+    return block;
+}
+
+void* platform_allocate_pages_aligned(u64 size, u64 alignment) {
+    // regions can not be trimmed, so reserve a larger one to find an aligned address and map exactly that
+    for (u32 attempt = 0; attempt < 8; ++attempt) {
+        u8* probe = VirtualAlloc(0, size + alignment, MEM_RESERVE, PAGE_NOACCESS);
+        if (!probe) {
+            break;
+        }
+        u8* aligned = (u8*)(((u64)probe + alignment - 1) & ~(alignment - 1));
+        VirtualFree(probe, 0, MEM_RELEASE);
+        void* block = VirtualAlloc(aligned, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (block) {
+            return block;
+        }
+    }
+    LOGE("platform_allocate_pages_aligned : VirtualAlloc failed");
+    return 0;
+}
+
+void platform_free_pages(void* block, u64 size) {
+    (void)size;
+    if (!VirtualFree(block, 0, MEM_RELEASE)) {
+        LOGE("platform_free_pages : VirtualFree failed");
+    }
+}
+
+void* platform_reallocate_pages(void* block, u64 old_size, u64 new_size) {
+    // there is no mremap, map the new size and copy over
+    void* moved = platform_allocate_pages(new_size);
+    if (!moved) {
+        LOGE("platform_reallocate_pages : VirtualAlloc failed");
+        return 0;
+    }
+    CopyMemory(moved, block, old_size < new_size ? old_size : new_size);
+    platform_free_pages(block, old_size);
+    return moved;
+}
+
 bool zthread_create(PFN_zthread_start func, void* params, zthread* out_thread) {
     if (!func || !out_thread) {
         LOGE("zthread_create : invalid params");
         return false;
     }
-    out_thread->internal_data = CreateThread(0, 0, (LPTHREAD_START_ROUTINE)func, params, 0, 0);
+    zthread_start_info* info = HeapAlloc(GetProcessHeap(), 0, sizeof(zthread_start_info));
+    if (info == 0) {
+        LOGE("zthread_create : failed to allocate memory");
+        return false;
+    }
+    info->func = func;
+    info->params = params;
+
+    out_thread->internal_data = CreateThread(0, 0, zthread_start, info, 0, 0);
     if (!out_thread->internal_data) {
         LOGE("zthread_create : failed to create zthread");
+        HeapFree(GetProcessHeap(), 0, info);
         return false;
     }
     return true;
@@ -74,6 +161,21 @@ bool zthread_wait_on_all(zthread* threads, u64 count) {
     return true;
 }
 
+bool zthread_register_exit_callback(PFN_zthread_exit func, void* params) {
+    if (!func) {
+        LOGE("zthread_register_exit_callback : invalid params");
+        return false;
+    }
+    if (exit_callback_count == ZTHREAD_MAX_EXIT_CALLBACKS) {
+        LOGW("zthread_register_exit_callback : too many callbacks");
+        return false;
+    }
+    exit_callbacks[exit_callback_count].func = func;
+    exit_callbacks[exit_callback_count].params = params;
+    exit_callback_count += 1;
+    return true;
+}
+
 bool zmutex_create(zmutex* out_mutex) {
     if (!out_mutex) {
         LOGE("zmutex_create : invalid params");
@@ -0,0 +1,20 @@
+#ifndef ZATOMIC__H
+#define ZATOMIC__H
+
+#include "defines.h"
+
+// thin wrappers over the gcc/clang __atomic builtins (clang is used on both platforms)
+#define zatomic_load(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define zatomic_load_relaxed(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define zatomic_store(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+#define zatomic_exchange(ptr, value) __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL)
+#define zatomic_fetch_add(ptr, value) __atomic_fetch_add(ptr, value, __ATOMIC_ACQ_REL)
+#define zatomic_fetch_sub(ptr, value) __atomic_fetch_sub(ptr, value, __ATOMIC_ACQ_REL)
+#define zatomic_fetch_or(ptr, value) __atomic_fetch_or(ptr, value, __ATOMIC_ACQ_REL)
+#define zatomic_fetch_and(ptr, value) __atomic_fetch_and(ptr, value, __ATOMIC_ACQ_REL)
+
+// on failure *expected is updated with the current value
+#define zatomic_compare_exchange(ptr, expected, desired) \
+    __atomic_compare_exchange_n(ptr, expected, desired, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+#endif
@@ -14,6 +14,10 @@ typedef u32 (*PFN_zthread_start)(void*);
 typedef void* (*PFN_zthread_start)(void*);
 #endif
 
+#define ZTHREAD_MAX_EXIT_CALLBACKS 8
+
+typedef void (*PFN_zthread_exit)(void*);
+
 bool zthread_create(PFN_zthread_start func, void* params, zthread* out_thread);
 
 void zthread_destroy(zthread* thread);
@@ -22,4 +26,7 @@ bool zthread_wait(zthread* thread);
 
 bool zthread_wait_on_all(zthread* threads, u64 count);
 
+// func runs on the calling thread after its start function returns (threads made by zthread_create only)
+bool zthread_register_exit_callback(PFN_zthread_exit func, void* params);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "buffer_pool.h"
+#include "pool_allocator.h"
+#include "zmemory.h"
+#include "logger.h"
+#include "zatomic.h"
+
+#define ALIGN_UP(val, alignment) (((val) + ((alignment) - 1)) & (~((alignment) - 1)))
+
+// the counts live in their own array so buffers stay all payload and releasing a reference never
+// dirties a cache line a consumer is reading from
+typedef struct buffer_pool {
+    u8* block;
+    u64 size;
+    u64 buffer_size;
+    u64 buffer_count;
+    u32* ref_counts;
+    u64 ref_counts_size;
+    pool_allocator* allocator;
+} buffer_pool;
+
+u32* buffer_pool_ref_count_of(buffer_pool* pool, buffer_slice slice, u64* out_index);
+
+buffer_pool* buffer_pool_create(u64 buffer_count, u64 buffer_size) {
+    if (buffer_count == 0 || buffer_size == 0) {
+        LOGE("buffer_pool_create : invalid params");
+        return 0;
+    }
+
+    buffer_pool* pool = zmemory_allocate(sizeof(buffer_pool));
+    pool->buffer_size = ALIGN_UP(buffer_size, 8);
+    pool->buffer_count = buffer_count;
+    pool->size = pool->buffer_count * pool->buffer_size;
+
+    pool->block = zmemory_allocate_pages(pool->size);
+    if (pool->block == 0) {
+        LOGE("buffer_pool_create : failed to allocate memory");
+        zmemory_free(pool, sizeof(buffer_pool));
+        return 0;
+    }
+    pool->ref_counts_size = buffer_count * sizeof(u32);
+    pool->ref_counts = zmemory_allocate_pages(pool->ref_counts_size);
+    if (pool->ref_counts == 0) {
+        LOGE("buffer_pool_create : failed to allocate reference counts");
+        zmemory_free_pages(pool->block, pool->size);
+        zmemory_free(pool, sizeof(buffer_pool));
+        return 0;
+    }
+
+    // the pool owns no header, so buffer i is always block + i * buffer_size
+    pool->allocator = pool_allocator_create_in_place(pool->block, pool->size, pool->buffer_size, POOL_ALLOCATOR_FLAG_NO_HEADER);
+    if (pool->allocator == 0) {
+        LOGE("buffer_pool_create : failed to create pool");
+        zmemory_free_pages(pool->ref_counts, pool->ref_counts_size);
+        zmemory_free_pages(pool->block, pool->size);
+        zmemory_free(pool, sizeof(buffer_pool));
+        return 0;
+    }
+
+    LOGT("buffer_pool_create");
+    return pool;
+}
+
+void buffer_pool_destroy(buffer_pool* pool) {
+    if (pool == 0) {
+        LOGE("buffer_pool_destroy : invalid params");
+        return;
+    }
+    u64 live = pool_allocator_live_count(pool->allocator);
+    if (live) {
+        LOGW("buffer_pool_destroy : %llu buffers are still referenced", live);
+    }
+    pool_allocator_destroy(pool->allocator);
+    zmemory_free_pages(pool->ref_counts, pool->ref_counts_size);
+    zmemory_free_pages(pool->block, pool->size);
+    zmemory_free(pool, sizeof(buffer_pool));
+}
+
+buffer_slice buffer_pool_acquire(buffer_pool* pool) {
+    buffer_slice slice = {0};
+    if (pool == 0) {
+        LOGE("buffer_pool_acquire : invalid params");
+        return slice;
+    }
+    u8* data = pool_allocator_allocate(pool->allocator);
+    if (data == 0) {
+        LOGW("buffer_pool_acquire : no free buffer");
+        return slice;
+    }
+    // nobody else can see the buffer yet, the store only has to be visible before it is shared
+    u64 index = (u64)(data - pool->block) / pool->buffer_size;
+    zatomic_store(&pool->ref_counts[index], 1);
+    slice.data = data;
+    slice.size = pool->buffer_size;
+    return slice;
+}
+
+buffer_slice buffer_pool_ref(buffer_pool* pool, buffer_slice slice) {
+    buffer_slice empty = {0};
+    if (pool == 0 || slice.data == 0) {
+        LOGE("buffer_pool_ref : invalid params");
+        return empty;
+    }
+    u32* ref_count = buffer_pool_ref_count_of(pool, slice, 0);
+    if (ref_count == 0) {
+        LOGE("buffer_pool_ref : invalid memory address");
+        return empty;
+    }
+    // a count of 0 means the buffer is already back in the pool, reviving it would hand it out twice
+    u32 count = zatomic_load_relaxed(ref_count);
+    do {
+        if (count == 0) {
+            LOGE("buffer_pool_ref : buffer has no references left");
+            return empty;
+        }
+    } while (!zatomic_compare_exchange(ref_count, &count, count + 1));
+    return slice;
+}
+
+void buffer_pool_unref(buffer_pool* pool, buffer_slice slice) {
+    if (pool == 0 || slice.data == 0) {
+        LOGE("buffer_pool_unref : invalid params");
+        return;
+    }
+    u64 index;
+    u32* ref_count = buffer_pool_ref_count_of(pool, slice, &index);
+    if (ref_count == 0) {
+        LOGE("buffer_pool_unref : invalid memory address");
+        return;
+    }
+    u32 count = zatomic_load_relaxed(ref_count);
+    do {
+        if (count == 0) {
+            LOGE("buffer_pool_unref : buffer has no references left");
+            return;
+        }
+    } while (!zatomic_compare_exchange(ref_count, &count, count - 1));
+    if (count == 1) {
+        pool_allocator_free(pool->allocator, pool->block + index * pool->buffer_size);
+    }
+}
+
+buffer_slice buffer_pool_slice(buffer_pool* pool, buffer_slice slice, u64 offset, u64 size) {
+    buffer_slice view = {0};
+    if (pool == 0 || slice.data == 0 || size == 0 || offset > slice.size || size > slice.size - offset) {
+        LOGE("buffer_pool_slice : invalid params");
+        return view;
+    }
+    if (buffer_pool_ref(pool, slice).data == 0) {
+        return view;
+    }
+    view.data = slice.data + offset;
+    view.size = size;
+    return view;
+}
+
+u32 buffer_pool_ref_count(buffer_pool* pool, buffer_slice slice) {
+    if (pool == 0 || slice.data == 0) {
+        LOGE("buffer_pool_ref_count : invalid params");
+        return 0;
+    }
+    u32* ref_count = buffer_pool_ref_count_of(pool, slice, 0);
+    if (ref_count == 0) {
+        LOGE("buffer_pool_ref_count : invalid memory address");
+        return 0;
+    }
+    return zatomic_load(ref_count);
+}
+
+u64 buffer_pool_buffer_size(buffer_pool* pool) {
+    if (pool == 0) {
+        LOGE("buffer_pool_buffer_size : invalid params");
+        return 0;
+    }
+    return pool->buffer_size;
+}
+
+// any slice, whole or partial, maps back to the count of the buffer it points into
+u32* buffer_pool_ref_count_of(buffer_pool* pool, buffer_slice slice, u64* out_index) {
+    u64 offset = (u64)slice.data - (u64)pool->block;
+    if ((u64)slice.data < (u64)pool->block || offset >= pool->size) {
+        return 0;
+    }
+    u64 index = offset / pool->buffer_size;
+    if (slice.size == 0 || slice.size > (index + 1) * pool->buffer_size - offset) {
+        return 0;
+    }
+    if (out_index) {
+        *out_index = index;
+    }
+    return &pool->ref_counts[index];
+}
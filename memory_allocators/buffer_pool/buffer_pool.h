@@ -0,0 +1,37 @@
+#ifndef BUFFER_POOL__H
+#define BUFFER_POOL__H
+
+#include "defines.h"
+
+// fixed size buffers shared between consumers without copying, every buffer carries an atomic reference count
+// kept outside the data and goes back to the pool when its last reference is dropped
+typedef struct buffer_pool buffer_pool;
+
+// a view over part of one buffer, every view a caller holds accounts for one reference
+typedef struct buffer_slice {
+    u8* data;
+    u64 size;
+} buffer_slice;
+
+buffer_pool* buffer_pool_create(u64 buffer_count, u64 buffer_size);
+
+// every reference must have been dropped
+void buffer_pool_destroy(buffer_pool* pool);
+
+// a whole buffer with one reference, the zeroed slice when the pool is empty
+buffer_slice buffer_pool_acquire(buffer_pool* pool);
+
+// one more reference to the buffer behind slice, returns slice
+buffer_slice buffer_pool_ref(buffer_pool* pool, buffer_slice slice);
+
+// drops one reference, the last one returns the buffer to the pool
+void buffer_pool_unref(buffer_pool* pool, buffer_slice slice);
+
+// a new reference viewing size bytes at offset inside slice, the zeroed slice when it does not fit
+buffer_slice buffer_pool_slice(buffer_pool* pool, buffer_slice slice, u64 offset, u64 size);
+
+u32 buffer_pool_ref_count(buffer_pool* pool, buffer_slice slice);
+
+u64 buffer_pool_buffer_size(buffer_pool* pool);
+
+#endif
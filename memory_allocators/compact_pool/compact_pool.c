@@ -0,0 +1,220 @@
+#include "compact_pool.h"
+#include "zmemory.h"
+#include "logger.h"
+#include "zmutex.h"
+
+#define IS_POWER_OF_TWO(val) (((val) != 0) && (((val) & ((val) - 1)) == 0))
+
+// free chunks hold the handle of the next free chunk in their first 4 bytes, there is no header,
+// double frees and foreign handles are caught by the side occupancy bitmap (1 bit per chunk)
+typedef struct compact_pool {
+    u8* block;
+    u64 size;
+    u64 chunk_size;
+    u32 chunk_shift; // 0 when chunk_size is not a power of two
+    u32 chunk_count;
+    u32 carved; // chunks below this index have been handed out at least once
+    u32 head;   // handle of the first free chunk
+    u64* occupancy;
+    u64 occupancy_size;
+    zmutex mutex;
+} compact_pool;
+
+u32 compact_pool_index_of(compact_pool* pool, void* block);
+u32 compact_pool_pop(compact_pool* pool);
+bool compact_pool_push(compact_pool* pool, u32 handle);
+
+compact_pool* compact_pool_create(u64 chunk_count, u64 chunk_size) {
+    if (chunk_count == 0 || chunk_count > COMPACT_POOL_MAX_CHUNKS || chunk_size < sizeof(u32) || (chunk_size & 3) != 0) {
+        LOGE("compact_pool_create : invalid params");
+        return 0;
+    }
+
+    compact_pool* pool = zmemory_allocate(sizeof(compact_pool));
+    pool->chunk_size = chunk_size;
+    pool->chunk_shift = IS_POWER_OF_TWO(chunk_size) ? __builtin_ctzll(chunk_size) : 0;
+    pool->chunk_count = (u32)chunk_count;
+    pool->size = chunk_count * chunk_size;
+
+    // pages are only faulted in once the tail is carved into chunks
+    pool->block = zmemory_allocate_pages(pool->size);
+    if (pool->block == 0) {
+        LOGE("compact_pool_create : failed to allocate memory");
+        zmemory_free(pool, sizeof(compact_pool));
+        return 0;
+    }
+    pool->occupancy_size = ((chunk_count + 63) >> 6) * sizeof(u64);
+    pool->occupancy = zmemory_allocate_pages(pool->occupancy_size);
+    if (pool->occupancy == 0) {
+        LOGE("compact_pool_create : failed to allocate occupancy bitmap");
+        zmemory_free_pages(pool->block, pool->size);
+        zmemory_free(pool, sizeof(compact_pool));
+        return 0;
+    }
+
+    if (!zmutex_create(&pool->mutex)) {
+        LOGE("compact_pool_create : failed to create zmutex");
+        zmemory_free_pages(pool->occupancy, pool->occupancy_size);
+        zmemory_free_pages(pool->block, pool->size);
+        zmemory_free(pool, sizeof(compact_pool));
+        return 0;
+    }
+
+    LOGT("compact_pool_create");
+    return pool;
+}
+
+void compact_pool_destroy(compact_pool* pool) {
+    if (pool == 0) {
+        LOGE("compact_pool_destroy : invalid params");
+        return;
+    }
+    zmutex_destroy(&pool->mutex);
+    zmemory_free_pages(pool->occupancy, pool->occupancy_size);
+    zmemory_free_pages(pool->block, pool->size);
+    zmemory_free(pool, sizeof(compact_pool));
+}
+
+u32 compact_pool_allocate_handle(compact_pool* pool) {
+    if (pool == 0) {
+        LOGE("compact_pool_allocate_handle : invalid params");
+        return COMPACT_POOL_INVALID_HANDLE;
+    }
+    zmutex_lock(&pool->mutex);
+    u32 handle = compact_pool_pop(pool);
+    zmutex_unlock(&pool->mutex);
+    if (handle == COMPACT_POOL_INVALID_HANDLE) {
+        LOGW("compact_pool_allocate_handle : no free space");
+    }
+    return handle;
+}
+
+void compact_pool_free_handle(compact_pool* pool, u32 handle) {
+    if (pool == 0 || handle == COMPACT_POOL_INVALID_HANDLE) {
+        LOGE("compact_pool_free_handle : invalid params");
+        return;
+    }
+    zmutex_lock(&pool->mutex);
+    bool freed = compact_pool_push(pool, handle);
+    zmutex_unlock(&pool->mutex);
+    if (!freed) {
+        LOGE("compact_pool_free_handle : invalid handle");
+    }
+}
+
+void* compact_pool_resolve(compact_pool* pool, u32 handle) {
+    if (pool == 0 || handle == COMPACT_POOL_INVALID_HANDLE || handle > pool->chunk_count) {
+        LOGE("compact_pool_resolve : invalid params");
+        return 0;
+    }
+    return pool->block + (u64)(handle - 1) * pool->chunk_size;
+}
+
+u32 compact_pool_handle_of(compact_pool* pool, void* block) {
+    if (pool == 0 || block == 0) {
+        LOGE("compact_pool_handle_of : invalid params");
+        return COMPACT_POOL_INVALID_HANDLE;
+    }
+    u32 index = compact_pool_index_of(pool, block);
+    if (index == pool->chunk_count) {
+        LOGE("compact_pool_handle_of : invalid memory address");
+        return COMPACT_POOL_INVALID_HANDLE;
+    }
+    return index + 1;
+}
+
+void* compact_pool_allocate(compact_pool* pool) {
+    if (pool == 0) {
+        LOGE("compact_pool_allocate : invalid params");
+        return 0;
+    }
+    zmutex_lock(&pool->mutex);
+    u32 handle = compact_pool_pop(pool);
+    zmutex_unlock(&pool->mutex);
+    if (handle == COMPACT_POOL_INVALID_HANDLE) {
+        LOGW("compact_pool_allocate : no free space");
+        return 0;
+    }
+    return pool->block + (u64)(handle - 1) * pool->chunk_size;
+}
+
+void compact_pool_free(compact_pool* pool, void* block) {
+    if (pool == 0 || block == 0) {
+        LOGE("compact_pool_free : invalid params");
+        return;
+    }
+    u32 index = compact_pool_index_of(pool, block);
+    bool freed = false;
+    if (index != pool->chunk_count) {
+        zmutex_lock(&pool->mutex);
+        freed = compact_pool_push(pool, index + 1);
+        zmutex_unlock(&pool->mutex);
+    }
+    if (!freed) {
+        LOGE("compact_pool_free : invalid memory address");
+    }
+}
+
+void compact_pool_reset(compact_pool* pool) {
+    if (pool == 0) {
+        LOGE("compact_pool_reset : invalid params");
+        return;
+    }
+    zmutex_lock(&pool->mutex);
+    // only the words covering the carved chunks can be dirty
+    zmemory_set_zero(pool->occupancy, (((u64)pool->carved + 63) >> 6) * sizeof(u64));
+    pool->carved = 0;
+    pool->head = COMPACT_POOL_INVALID_HANDLE;
+    zmutex_unlock(&pool->mutex);
+}
+
+u64 compact_pool_chunk_size(compact_pool* pool) {
+    if (pool == 0) {
+        LOGE("compact_pool_chunk_size : invalid params");
+        return 0;
+    }
+    return pool->chunk_size;
+}
+
+// chunk_count when block is not the start of a chunk in this pool
+u32 compact_pool_index_of(compact_pool* pool, void* block) {
+    u64 offset = (u64)block - (u64)pool->block;
+    if ((u64)block < (u64)pool->block || offset >= pool->size) {
+        return pool->chunk_count;
+    }
+    // power of two chunks skip the division
+    u64 index = pool->chunk_shift ? offset >> pool->chunk_shift : offset / pool->chunk_size;
+    if (index * pool->chunk_size != offset) {
+        return pool->chunk_count;
+    }
+    return (u32)index;
+}
+
+u32 compact_pool_pop(compact_pool* pool) {
+    u32 handle = pool->head;
+    if (handle != COMPACT_POOL_INVALID_HANDLE) {
+        pool->head = *(u32*)(pool->block + (u64)(handle - 1) * pool->chunk_size);
+    } else if (pool->carved < pool->chunk_count) {
+        handle = ++pool->carved;
+    } else {
+        return COMPACT_POOL_INVALID_HANDLE;
+    }
+    u32 index = handle - 1;
+    pool->occupancy[index >> 6] |= 1ull << (index & 63);
+    return handle;
+}
+
+bool compact_pool_push(compact_pool* pool, u32 handle) {
+    u32 index = handle - 1;
+    if (handle > pool->carved) {
+        return false;
+    }
+    u64 bit = 1ull << (index & 63);
+    if ((pool->occupancy[index >> 6] & bit) == 0) {
+        return false;
+    }
+    pool->occupancy[index >> 6] &= ~bit;
+    *(u32*)(pool->block + (u64)index * pool->chunk_size) = pool->head;
+    pool->head = handle;
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef COMPACT_POOL__H
+#define COMPACT_POOL__H
+
+#include "defines.h"
+
+// handle = chunk index + 1, so a zeroed handle field never refers to a live chunk
+#define COMPACT_POOL_INVALID_HANDLE 0u
+#define COMPACT_POOL_MAX_CHUNKS 0xFFFFFFFEull
+
+typedef struct compact_pool compact_pool;
+
+// free chunks are linked by u32 index, so chunk_size only has to be a multiple of 4
+compact_pool* compact_pool_create(u64 chunk_count, u64 chunk_size);
+
+void compact_pool_destroy(compact_pool* pool);
+
+u32 compact_pool_allocate_handle(compact_pool* pool);
+
+void compact_pool_free_handle(compact_pool* pool, u32 handle);
+
+// no validation beyond the range check, meant for hot paths that already own the handle
+void* compact_pool_resolve(compact_pool* pool, u32 handle);
+
+u32 compact_pool_handle_of(compact_pool* pool, void* block);
+
+void* compact_pool_allocate(compact_pool* pool);
+
+void compact_pool_free(compact_pool* pool, void* block);
+
+void compact_pool_reset(compact_pool* pool);
+
+u64 compact_pool_chunk_size(compact_pool* pool);
+
+#endif
@@ -2,6 +2,7 @@
 #include "logger.h"
 #include "zmemory.h"
 #include "zmutex.h"
+#include "platform.h"
 #include "unordered_set.h"
 
 ////////////////////////////////////////////////////////////////////////
@@ -19,63 +20,244 @@
 
 #define ALIGN_UP(val, alignment) (((val) + ((alignment) - 1)) & (~((alignment) - 1)))
 #define IS_POWER_OF_TWO(val) (((val) != 0) && (((val) & ((val) - 1)) == 0))
-#define FREELIST_HEADER_SIZE sizeof(freelist_header)
+// an allocated block only keeps the size word in front of its payload
+#define FREELIST_HEADER_SIZE sizeof(u64)
+
+// boundary tags : sizes are multiples of 8, the low bit of size says whether the physically previous block is free,
+// free blocks repeat their size in their last 8 bytes so the next block can find their start
+#define FREELIST_PREV_FREE 1ull
+// the top 16 bits of size hold FREELIST_ALLOCATED_TAG while the block is allocated, free checks against it
+#define FREELIST_ALLOCATED_TAG 0xF7B3ull
+#define FREELIST_TAG_SHIFT 48
+#define FREELIST_MAX_SIZE (1ull << (FREELIST_TAG_SHIFT - 1))
+#define FREELIST_SIZE_MASK (((1ull << FREELIST_TAG_SHIFT) - 1) & ~7ull)
+#define FREELIST_BLOCK_SIZE(node) ((node)->size & FREELIST_SIZE_MASK)
+#define FREELIST_IS_ALLOCATED(node) (((node)->size >> FREELIST_TAG_SHIFT) == FREELIST_ALLOCATED_TAG)
+#define FREELIST_FOOTER_SIZE sizeof(u64)
+// free blocks need their links and footer, so no block is ever smaller
+#define FREELIST_MIN_FREE_SIZE (sizeof(freelist_header) + FREELIST_FOOTER_SIZE)
+
+// tlsf : the first level splits sizes by power of two, the second level splits every doubling into
+// FREELIST_TLSF_SL_COUNT linear classes, below FREELIST_TLSF_SMALL_SIZE classes are 8 bytes apart
+#define FREELIST_TLSF_SL_SHIFT 4
+#define FREELIST_TLSF_SL_COUNT (1 << FREELIST_TLSF_SL_SHIFT)
+#define FREELIST_TLSF_FL_SHIFT (FREELIST_TLSF_SL_SHIFT + 3)
+#define FREELIST_TLSF_SMALL_SIZE (1ull << FREELIST_TLSF_FL_SHIFT)
+#define FREELIST_TLSF_FL_COUNT (64 - FREELIST_TLSF_FL_SHIFT + 1)
+
+#define FREELIST_REGION_HEADER_SIZE sizeof(freelist_region)
+
+#define FREELIST_HUGE_MIN_CAPACITY 16
 
 typedef struct freelist_header {
-    u64 unique; // 0xF7B3D591E6A4C208
     u64 size;
-    struct freelist_header* next;
-    struct freelist_header* prev;
+    // only while free, allocated blocks hand these bytes out
+    union {
+        struct {
+            struct freelist_header* next;
+            struct freelist_header* prev;
+        };
+        // FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE, ordered by size then address
+        struct {
+            struct freelist_header* left;
+            struct freelist_header* right;
+        };
+    };
 } freelist_header;
 
+typedef struct freelist_tlsf {
+    u64 fl_bitmap;                          // bit f set when any class of first level f holds a block
+    u32 sl_bitmap[FREELIST_TLSF_FL_COUNT]; // bit s set when heads[f][s] holds a block
+    freelist_header* heads[FREELIST_TLSF_FL_COUNT][FREELIST_TLSF_SL_COUNT];
+} freelist_tlsf;
+
+// sits at the start of every region of a growable allocator, regions are aligned to their size
+// so the region of any block is a mask away
+typedef struct freelist_region {
+    struct freelist_region* next;
+    struct freelist_region* prev;
+} freelist_region;
+
+// a block on the direct path, keyed by its page aligned address
+typedef struct freelist_huge {
+    u64 address; // 0 while the slot is empty
+    u64 size;    // mapped bytes, a multiple of the page size
+} freelist_huge;
+
 typedef struct freelist_allocator {
     void* block;
-    u64 size;
+    bool external_block; // freelist_allocator_create_in_place, the block belongs to the caller
+    u64 size;        // bytes blocks can be carved from, summed over the mapped regions when growable
+    u64 capacity;    // largest block a single range holds
+    u64 region_size; // 0 unless growable
+    freelist_region* regions;
+    unordered_set* region_set; // region addresses, so frees of foreign pointers never touch unmapped memory
     u64 used;
+    freelist_allocator_policy policy;
     freelist_header* head;
+    freelist_header* rover; // FREELIST_ALLOCATOR_POLICY_NEXT_FIT, where the next search starts
+    freelist_tlsf* tlsf;
+    freelist_header* root;
+    u64 page_size;
+    u64 huge_threshold; // 0 when every request goes through the free blocks
+    u64 huge_used;
+    freelist_huge* huge; // open addressing, at most half full so every probe ends on an empty slot
+    u64 huge_capacity;
+    u64 huge_count;
     zmutex mutex;
 } freelist_allocator;
 
 freelist_header* get_best_fit_block(freelist_header* node, u64 size);
-void freelist_coalescing(freelist_allocator* allocator);
+freelist_header* get_first_fit_block(freelist_header* node, freelist_header* end, u64 size);
+freelist_header* get_next_fit_block(freelist_allocator* allocator, u64 size);
+void freelist_mark_free(freelist_allocator* allocator, freelist_header* node);
+void freelist_mark_allocated(freelist_allocator* allocator, freelist_header* node);
+void freelist_trim(freelist_allocator* allocator, freelist_header* node, u64 keep_size);
+freelist_header* freelist_validate(freelist_allocator* allocator, void* block);
+u64 freelist_required_size(u64 size);
+u64 freelist_range_end(freelist_allocator* allocator, freelist_header* node);
+u64 freelist_range_largest(u8* start, u64 size);
+freelist_header* freelist_region_map(freelist_allocator* allocator);
+void freelist_region_unmap(freelist_allocator* allocator, freelist_region* region);
+freelist_header* freelist_find(freelist_allocator* allocator, u64 size);
+freelist_header* freelist_find_or_grow(freelist_allocator* allocator, u64 size);
+bool freelist_is_huge(freelist_allocator* allocator, u64 size);
+bool freelist_size_valid(freelist_allocator* allocator, u64 size);
+void* freelist_huge_allocate(freelist_allocator* allocator, u64 size);
+void* freelist_huge_reallocate(freelist_allocator* allocator, void* block, u64 size);
+void* freelist_reallocate_move(freelist_allocator* allocator, void* block, u64 copy_size, u64 size);
+u64 freelist_huge_slot(freelist_allocator* allocator, u64 address);
+freelist_huge* freelist_huge_find(freelist_allocator* allocator, void* block);
+void freelist_huge_insert(freelist_allocator* allocator, void* block, u64 size);
+void freelist_huge_remove(freelist_allocator* allocator, freelist_huge* entry);
+void freelist_huge_release(freelist_allocator* allocator);
+void freelist_insert(freelist_allocator* allocator, freelist_header* node);
+void freelist_remove(freelist_allocator* allocator, freelist_header* node);
+void freelist_tlsf_mapping(u64 size, u32* out_fl, u32* out_sl);
+freelist_header* freelist_tlsf_find(freelist_tlsf* tlsf, u64 size);
+void freelist_tlsf_insert(freelist_tlsf* tlsf, freelist_header* node);
+void freelist_tlsf_remove(freelist_tlsf* tlsf, freelist_header* node);
+bool freelist_tree_less(freelist_header* a, freelist_header* b);
+u64 freelist_tree_priority(freelist_header* node);
+freelist_header* freelist_tree_find(freelist_header* node, u64 size);
+void freelist_tree_insert(freelist_allocator* allocator, freelist_header* node);
+void freelist_tree_remove(freelist_allocator* allocator, freelist_header* node);
+freelist_allocator* freelist_create(void* block, u64 size, freelist_allocator_policy policy);
+
+freelist_allocator* freelist_allocator_create_with_policy(u64 size, freelist_allocator_policy policy) {
+    return freelist_create(0, size, policy);
+}
 
-freelist_allocator* freelist_allocator_create(u64 size) {
-    if (size == 0 || IS_POWER_OF_TWO(size) == 0) {
+freelist_allocator* freelist_allocator_create_in_place(void* block, u64 size, freelist_allocator_policy policy) {
+    if (block == 0 || ((u64)block & 7) != 0) {
+        LOGE("freelist_allocator_create_in_place : invalid params");
+        return 0;
+    }
+    return freelist_create(block, size, policy);
+}
+
+freelist_allocator* freelist_create(void* block, u64 size, freelist_allocator_policy policy) {
+    if (size == 0 || IS_POWER_OF_TWO(size) == 0 || size > FREELIST_MAX_SIZE || policy > FREELIST_ALLOCATOR_POLICY_NEXT_FIT) {
         LOGE("freelist_allocator_create : invalid params");
         return 0;
     }
 
     freelist_allocator* allocator = zmemory_allocate(sizeof(freelist_allocator));
-    allocator->block = zmemory_allocate(size);
+    allocator->external_block = block != 0;
+    allocator->block = block ? block : zmemory_allocate(size);
     if (allocator->block == 0) {
         LOGE("freelist_allocator_create:failed to allocate memory");
         zmemory_free(allocator, sizeof(freelist_allocator));
         return 0;
     }
     allocator->size = size;
+    allocator->capacity = size;
     allocator->used = 0;
-    allocator->head = allocator->block;
-    allocator->head->unique = 0;
-    allocator->head->size = size;
-    allocator->head->next = 0;
-    allocator->head->prev = 0;
+    allocator->policy = policy;
+    allocator->page_size = platform_page_size();
+    if (policy == FREELIST_ALLOCATOR_POLICY_TLSF) {
+        allocator->tlsf = zmemory_allocate(sizeof(freelist_tlsf));
+    }
     if (!zmutex_create(&allocator->mutex)) {
         LOGE("freelist_allocator_create : failed to create mutex");
-        zmemory_free(allocator->block, size);
+        if (allocator->tlsf) {
+            zmemory_free(allocator->tlsf, sizeof(freelist_tlsf));
+        }
+        if (!allocator->external_block) {
+            zmemory_free(allocator->block, size);
+        }
         zmemory_free(allocator, sizeof(freelist_allocator));
         return 0;
     }
+    freelist_allocator_reset(allocator);
     LOGT("freelist_allocator_create");
     return allocator;
 }
 
+freelist_allocator* freelist_allocator_create_growable(u64 region_size, freelist_allocator_policy policy) {
+    u64 rounded_region_size = platform_page_size();
+    while (rounded_region_size < region_size) {
+        rounded_region_size <<= 1;
+    }
+
+    if (region_size == 0 || rounded_region_size > FREELIST_MAX_SIZE || policy > FREELIST_ALLOCATOR_POLICY_NEXT_FIT) {
+        LOGE("freelist_allocator_create_growable : invalid params");
+        return 0;
+    }
+
+    freelist_allocator* allocator = zmemory_allocate(sizeof(freelist_allocator));
+    allocator->region_size = rounded_region_size;
+    allocator->capacity = rounded_region_size - FREELIST_REGION_HEADER_SIZE;
+    allocator->policy = policy;
+    allocator->page_size = platform_page_size();
+    allocator->huge_threshold = FREELIST_ALLOCATOR_DEFAULT_HUGE_THRESHOLD;
+    allocator->region_set = unordered_set_create(freelist_region*, 0);
+    if (policy == FREELIST_ALLOCATOR_POLICY_TLSF) {
+        allocator->tlsf = zmemory_allocate(sizeof(freelist_tlsf));
+    }
+    if (!zmutex_create(&allocator->mutex)) {
+        LOGE("freelist_allocator_create_growable : failed to create mutex");
+        if (allocator->tlsf) {
+            zmemory_free(allocator->tlsf, sizeof(freelist_tlsf));
+        }
+        unordered_set_destroy(allocator->region_set);
+        zmemory_free(allocator, sizeof(freelist_allocator));
+        return 0;
+    }
+    // maps the first region
+    freelist_allocator_reset(allocator);
+    if (allocator->regions == 0) {
+        LOGE("freelist_allocator_create_growable : failed to allocate memory");
+        freelist_allocator_destroy(allocator);
+        return 0;
+    }
+    LOGT("freelist_allocator_create_growable");
+    return allocator;
+}
+
 void freelist_allocator_destroy(freelist_allocator* allocator) {
     if (allocator == 0) {
         LOGE("freelist_allocator_destroy : invalid params");
         return;
     }
     zmutex_destroy(&allocator->mutex);
-    zmemory_free(allocator->block, allocator->size);
+    if (allocator->tlsf) {
+        zmemory_free(allocator->tlsf, sizeof(freelist_tlsf));
+    }
+    freelist_huge_release(allocator);
+    if (allocator->huge) {
+        zmemory_free(allocator->huge, sizeof(freelist_huge) * allocator->huge_capacity);
+    }
+    if (allocator->region_size) {
+        while (allocator->regions) {
+            freelist_region* next = allocator->regions->next;
+            zmemory_free_pages(allocator->regions, allocator->region_size);
+            allocator->regions = next;
+        }
+        unordered_set_destroy(allocator->region_set);
+    } else if (!allocator->external_block) {
+        zmemory_free(allocator->block, allocator->size);
+    }
     zmemory_free(allocator, sizeof(freelist_allocator));
 
     LOGT("freelist_allocator_destroy");
@@ -83,72 +265,82 @@ void freelist_allocator_destroy(freelist_allocator* allocator) {
 
 // default 8 byte alignment;
 void* freelist_allocator_allocate(freelist_allocator* allocator, u64 size) {
-    if (allocator == 0 || size == 0 || size >= allocator->size) {
+    if (allocator == 0 || !freelist_size_valid(allocator, size)) {
         LOGE("freelist_allocator_allocate : invalid params");
         return 0;
     }
+    if (freelist_is_huge(allocator, size)) {
+        return freelist_huge_allocate(allocator, size);
+    }
 
-    if (allocator->head == 0 || (allocator->size - allocator->used) <= size) {
+    if (allocator->region_size == 0 && (allocator->size - allocator->used) <= size) {
         LOGW("freelist_allocator_allocate : no free space");
         return 0;
     }
 
     zmutex_lock(&allocator->mutex);
 
-    freelist_header* block = get_best_fit_block(allocator->head, size + FREELIST_HEADER_SIZE);
+    u64 required_size = freelist_required_size(size);
+    freelist_header* block = freelist_find_or_grow(allocator, required_size);
     if (block == 0) {
-        freelist_coalescing(allocator);
+        LOGW("freelist_allocator_allocate: no free space");
+        zmutex_unlock(&allocator->mutex);
+        return 0;
+    }
+    freelist_remove(allocator, block);
+    freelist_trim(allocator, block, required_size);
 
-        block = get_best_fit_block(allocator->head, size + FREELIST_HEADER_SIZE);
-        if (block == 0) {
-            LOGW("freelist_allocator_allocate: no free space");
-            zmutex_unlock(&allocator->mutex);
-            return 0;
-        }
+    block->size |= FREELIST_ALLOCATED_TAG << FREELIST_TAG_SHIFT;
+    // a block too small to split is handed out whole, used tracks what free gives back
+    allocator->used += FREELIST_BLOCK_SIZE(block);
+
+    zmutex_unlock(&allocator->mutex);
+
+    return (u8*)block + FREELIST_HEADER_SIZE;
+}
+
+void* freelist_allocator_allocate_aligned(freelist_allocator* allocator, u64 size, u64 alignment) {
+    if (allocator == 0 || !freelist_size_valid(allocator, size) || IS_POWER_OF_TWO(alignment) == 0 || alignment > allocator->page_size) {
+        LOGE("freelist_allocator_allocate_aligned : invalid params");
+        return 0;
     }
-    u64 start_addr = (u64)block;
-    u64 end_addr = (u64)block + FREELIST_HEADER_SIZE + size;
-    u64 aligned_end_addr = ALIGN_UP(end_addr, 8);
-    u64 used_size = aligned_end_addr - start_addr;
-    u64 unused_size = block->size - used_size;
-    // only then split the block
-    if (unused_size > FREELIST_HEADER_SIZE) {
-        freelist_header* split = (freelist_header*)aligned_end_addr;
-        split->prev = block->prev;
-        split->next = block->next;
-        split->size = unused_size;
-        split->unique = 0;
-
-        if (block->prev == 0) {
-            allocator->head = split;
-            if (block->next) {
-                block->next->prev = split;
-            }
-        } else {
-            block->prev->next = split;
-            if (block->next) {
-                block->next->prev = split;
-            }
-        }
-        block->size = used_size;
-    } else {
-        if (block->prev == 0) {
-            allocator->head = block->next;
-            if (block->next) {
-                block->next->prev = 0;
-            }
-        } else {
-            block->prev->next = block->next;
-            if (block->next) {
-                block->next->prev = block->prev;
-            }
-        }
+    // pages are aligned well enough for the direct path
+    if (alignment <= 8 || freelist_is_huge(allocator, size)) {
+        return freelist_allocator_allocate(allocator, size);
+    }
+
+    zmutex_lock(&allocator->mutex);
+
+    // room for the block plus the worst padding, which has to be 0 or a whole free block
+    u64 required_size = freelist_required_size(size);
+    freelist_header* block = freelist_find_or_grow(allocator, required_size + alignment + FREELIST_MIN_FREE_SIZE);
+    if (block == 0) {
+        LOGW("freelist_allocator_allocate_aligned : no free space");
+        zmutex_unlock(&allocator->mutex);
+        return 0;
     }
+    freelist_remove(allocator, block);
 
-    block->next = 0;
-    block->prev = 0;
-    block->unique = 0xF7B3D591E6A4C208;
-    allocator->used += used_size;
+    u64 payload = ALIGN_UP((u64)block + FREELIST_HEADER_SIZE, alignment);
+    u64 lead_size = payload - FREELIST_HEADER_SIZE - (u64)block;
+    // a lead too small to stand on its own is pushed out to the next aligned address
+    while (lead_size != 0 && lead_size < FREELIST_MIN_FREE_SIZE) {
+        payload += alignment;
+        lead_size += alignment;
+    }
+    if (lead_size) {
+        // the padding goes back as a free block of its own
+        freelist_header* aligned = (freelist_header*)(payload - FREELIST_HEADER_SIZE);
+        aligned->size = FREELIST_BLOCK_SIZE(block) - lead_size;
+        block->size = lead_size;
+        freelist_mark_free(allocator, block);
+        freelist_insert(allocator, block);
+        block = aligned;
+    }
+    freelist_trim(allocator, block, required_size);
+
+    block->size |= FREELIST_ALLOCATED_TAG << FREELIST_TAG_SHIFT;
+    allocator->used += FREELIST_BLOCK_SIZE(block);
 
     zmutex_unlock(&allocator->mutex);
 
@@ -162,56 +354,102 @@ void freelist_allocator_free(freelist_allocator* allocator, void* block) {
     }
     zmutex_lock(&allocator->mutex);
 
-    freelist_header* remove_block = (freelist_header*)((u8*)block - FREELIST_HEADER_SIZE);
-    if (((u64)remove_block < (u64)allocator->block) ||
-        ((u64)remove_block >= ((u64)allocator->block + allocator->size)) ||
-        remove_block->unique != 0xF7B3D591E6A4C208) {
+    freelist_huge* huge = freelist_huge_find(allocator, block);
+    if (huge) {
+        u64 mapped_size = huge->size;
+        freelist_huge_remove(allocator, huge);
+        zmutex_unlock(&allocator->mutex);
+        // straight back to the OS, outside the lock
+        zmemory_free_pages(block, mapped_size);
+        return;
+    }
+
+    freelist_header* remove_block = freelist_validate(allocator, block);
+    if (remove_block == 0) {
         LOGE("freelist_allocator_free : invalid block addr");
+        zmutex_unlock(&allocator->mutex);
         return;
     }
 
-    allocator->used -= remove_block->size;
+    allocator->used -= FREELIST_BLOCK_SIZE(remove_block);
 
-    remove_block->unique = 0;
+    remove_block->size &= ~(FREELIST_ALLOCATED_TAG << FREELIST_TAG_SHIFT);
 
-    freelist_header* node = allocator->head;
-    freelist_header* prev = 0;
-    u64 next_block;
-    u64 prev_block;
+    // both physical neighbours are found through the boundary tags, no list walk
+    if (remove_block->size & FREELIST_PREV_FREE) {
+        u64 prev_size = *((u64*)remove_block - 1);
+        freelist_header* prev_block = (freelist_header*)((u8*)remove_block - prev_size);
+        freelist_remove(allocator, prev_block);
+        prev_block->size += FREELIST_BLOCK_SIZE(remove_block);
+        remove_block = prev_block;
+    }
+    freelist_header* next_block = (freelist_header*)((u8*)remove_block + FREELIST_BLOCK_SIZE(remove_block));
+    if ((u64)next_block < freelist_range_end(allocator, remove_block) && !FREELIST_IS_ALLOCATED(next_block)) {
+        freelist_remove(allocator, next_block);
+        remove_block->size += FREELIST_BLOCK_SIZE(next_block);
+    }
+    if (allocator->region_size && FREELIST_BLOCK_SIZE(remove_block) == allocator->capacity && allocator->regions->next) {
+        // the whole region is free again, the last one stays mapped so a lone block does not map and unmap on every call
+        freelist_region_unmap(allocator, (freelist_region*)((u8*)remove_block - FREELIST_REGION_HEADER_SIZE));
+    } else {
+        freelist_mark_free(allocator, remove_block);
+        freelist_insert(allocator, remove_block);
+    }
 
-    while (node) {
-        next_block = (u64)node + node->size;
-        prev_block = (u64)node - remove_block->size;
-        if (next_block == (u64)remove_block) {
-            node->size += remove_block->size;
-            zmutex_unlock(&allocator->mutex);
-            return;
-        } else if (prev_block == (u64)remove_block) {
-            remove_block->next = node->next;
-            remove_block->prev = node->prev;
-            remove_block->size += node->size;
-
-            if (node->prev) {
-                node->prev->next = remove_block;
-            } else {
-                allocator->head = remove_block;
-            }
-            if (node->next) {
-                node->next->prev = remove_block;
-            }
-            node->unique = 0;
+    zmutex_unlock(&allocator->mutex);
+}
+
+void* freelist_allocator_reallocate(freelist_allocator* allocator, void* block, u64 size) {
+    if (allocator == 0 || (size && !freelist_size_valid(allocator, size))) {
+        LOGE("freelist_allocator_reallocate : invalid params");
+        return 0;
+    }
+    if (block == 0) {
+        return freelist_allocator_allocate(allocator, size);
+    }
+    if (size == 0) {
+        freelist_allocator_free(allocator, block);
+        return 0;
+    }
+
+    zmutex_lock(&allocator->mutex);
+
+    if (freelist_huge_find(allocator, block)) {
+        zmutex_unlock(&allocator->mutex);
+        return freelist_huge_reallocate(allocator, block, size);
+    }
+
+    freelist_header* node = freelist_validate(allocator, block);
+    if (node == 0) {
+        LOGE("freelist_allocator_reallocate : invalid block addr");
+        zmutex_unlock(&allocator->mutex);
+        return 0;
+    }
+
+    u64 required_size = freelist_required_size(size);
+    u64 old_size = FREELIST_BLOCK_SIZE(node);
+    if (freelist_is_huge(allocator, size)) {
+        // onto pages of its own, later growth is a remap
+        zmutex_unlock(&allocator->mutex);
+        return freelist_reallocate_move(allocator, block, old_size - FREELIST_HEADER_SIZE, size);
+    }
+    if (required_size > old_size) {
+        // grow into the next block when it is free and large enough
+        freelist_header* next_node = (freelist_header*)((u8*)node + old_size);
+        if ((u64)next_node >= freelist_range_end(allocator, node) || FREELIST_IS_ALLOCATED(next_node) ||
+            old_size + FREELIST_BLOCK_SIZE(next_node) < required_size) {
             zmutex_unlock(&allocator->mutex);
-            return;
+            return freelist_reallocate_move(allocator, block, old_size - FREELIST_HEADER_SIZE, size);
         }
-        prev = node;
-        node = node->next;
+        freelist_remove(allocator, next_node);
+        node->size += FREELIST_BLOCK_SIZE(next_node);
     }
-
-    prev->next = remove_block;
-    remove_block->next = 0;
-    remove_block->prev = prev;
+    // what the block does not need any more goes back, merged with a free next block
+    freelist_trim(allocator, node, required_size);
+    allocator->used = allocator->used - old_size + FREELIST_BLOCK_SIZE(node);
 
     zmutex_unlock(&allocator->mutex);
+    return block;
 }
 
 void freelist_allocator_reset(freelist_allocator* allocator) {
@@ -221,11 +459,29 @@ void freelist_allocator_reset(freelist_allocator* allocator) {
     }
     zmutex_lock(&allocator->mutex);
 
-    allocator->head = allocator->block;
-    allocator->head->next = 0;
-    allocator->head->prev = 0;
-    allocator->head->size = allocator->size;
-    allocator->head->unique = 0;
+    freelist_huge_release(allocator);
+    allocator->head = 0;
+    allocator->rover = 0;
+    allocator->root = 0;
+    if (allocator->tlsf) {
+        zmemory_set_zero(allocator->tlsf, sizeof(freelist_tlsf));
+    }
+    freelist_header* node = allocator->block;
+    if (allocator->region_size) {
+        // everything but one region goes back to the OS
+        while (allocator->regions && allocator->regions->next) {
+            freelist_region_unmap(allocator, allocator->regions->next);
+        }
+        node = allocator->regions ? (freelist_header*)((u8*)allocator->regions + FREELIST_REGION_HEADER_SIZE)
+                                  : freelist_region_map(allocator);
+        if (node == 0) {
+            zmutex_unlock(&allocator->mutex);
+            return;
+        }
+    }
+    node->size = allocator->capacity;
+    freelist_mark_free(allocator, node);
+    freelist_insert(allocator, node);
     allocator->used = 0;
 
     zmutex_unlock(&allocator->mutex);
@@ -239,10 +495,44 @@ u64 freelist_allocator_unused_memory(freelist_allocator* allocator) {
     return allocator->size - allocator->used;
 }
 
+void freelist_allocator_set_huge_threshold(freelist_allocator* allocator, u64 threshold) {
+    if (allocator == 0) {
+        LOGE("freelist_allocator_set_huge_threshold : invalid params");
+        return;
+    }
+    zmutex_lock(&allocator->mutex);
+    allocator->huge_threshold = threshold;
+    zmutex_unlock(&allocator->mutex);
+}
+
+u64 freelist_allocator_huge_memory(freelist_allocator* allocator) {
+    if (allocator == 0) {
+        LOGE("freelist_allocator_huge_memory : invalid params");
+        return 0;
+    }
+    return allocator->huge_used;
+}
+
 u64 freelist_allocator_header_size() {
     return FREELIST_HEADER_SIZE;
 }
 
+u64 freelist_allocator_largest_free_block(freelist_allocator* allocator) {
+    if (allocator == 0) {
+        LOGE("freelist_allocator_largest_free_block : invalid params");
+        return 0;
+    }
+    zmutex_lock(&allocator->mutex);
+    u64 largest = allocator->region_size ? 0 : freelist_range_largest(allocator->block, allocator->size);
+    for (freelist_region* region = allocator->regions; region; region = region->next) {
+        u64 region_largest = freelist_range_largest((u8*)region + FREELIST_REGION_HEADER_SIZE, allocator->capacity);
+        largest = region_largest > largest ? region_largest : largest;
+    }
+    zmutex_unlock(&allocator->mutex);
+    // what a single allocation could still get
+    return largest ? largest - FREELIST_HEADER_SIZE : 0;
+}
+
 //////////////////////////////////////////////////////////////////////
 //  __                  __                                          //
 // /  |                /  |                                         //
@@ -261,52 +551,527 @@ u64 freelist_allocator_header_size() {
 
 freelist_header* get_best_fit_block(freelist_header* node, u64 size) {
     freelist_header* best = 0;
-    u64 min_extra = 100000000;
+    u64 min_extra = (u64)-1;
 
     while (node) {
-        if (node->size >= size && (node->size - size) < min_extra) {
-            min_extra = node->size - size;
+        u64 node_size = FREELIST_BLOCK_SIZE(node);
+        if (node_size >= size && (node_size - size) < min_extra) {
+            min_extra = node_size - size;
             best = node;
+            if (min_extra == 0) {
+                break;
+            }
         }
         node = node->next;
     }
     return best;
 }
 
-void freelist_coalescing(freelist_allocator* allocator) {
-    LOGT("freelist_allocator : undergoing coalescing ");
-
-    freelist_header* node = allocator->head;
-    unordered_set* set = unordered_set_create(freelist_header*, 0);
-    while (node) {
-        unordered_set_insert(set, node);
+// searches from node up to, not including, end
+freelist_header* get_first_fit_block(freelist_header* node, freelist_header* end, u64 size) {
+    while (node != end) {
+        if (FREELIST_BLOCK_SIZE(node) >= size) {
+            return node;
+        }
         node = node->next;
     }
+    return 0;
+}
 
-    node = allocator->head;
-    while (node) {
-        freelist_header* next_node = (freelist_header*)((u8*)node + node->size);
-        while (unordered_set_contains(set, next_node)) {
-            node->size += next_node->size;
-            if (next_node->prev) {
-                next_node->prev->next = next_node->next;
-            } else {
-                if (next_node->next)
-                    allocator->head = next_node->next;
+freelist_header* get_next_fit_block(freelist_allocator* allocator, u64 size) {
+    // from the rover to the tail, then wrap around from the head back to the rover
+    freelist_header* block = get_first_fit_block(allocator->rover ? allocator->rover : allocator->head, 0, size);
+    if (block == 0 && allocator->rover) {
+        block = get_first_fit_block(allocator->head, allocator->rover, size);
+    }
+    // removing the block moves the rover on to its successor
+    allocator->rover = block ? block : allocator->rover;
+    return block;
+}
+
+// writes the footer and tells the next block its neighbour is free
+void freelist_mark_free(freelist_allocator* allocator, freelist_header* node) {
+    u64 size = FREELIST_BLOCK_SIZE(node);
+    *(u64*)((u8*)node + size - FREELIST_FOOTER_SIZE) = size;
+    freelist_header* next_node = (freelist_header*)((u8*)node + size);
+    if ((u64)next_node < freelist_range_end(allocator, node)) {
+        next_node->size |= FREELIST_PREV_FREE;
+    }
+}
+
+void freelist_mark_allocated(freelist_allocator* allocator, freelist_header* node) {
+    freelist_header* next_node = (freelist_header*)((u8*)node + FREELIST_BLOCK_SIZE(node));
+    if ((u64)next_node < freelist_range_end(allocator, node)) {
+        next_node->size &= ~FREELIST_PREV_FREE;
+    }
+}
+
+// cuts an allocated or just removed block down to keep_size, the tail becomes a free block when it can hold
+// a header and footer on its own or when it can join a free next block, otherwise the block keeps it
+void freelist_trim(freelist_allocator* allocator, freelist_header* node, u64 keep_size) {
+    u64 size = FREELIST_BLOCK_SIZE(node);
+    u64 tail_size = size - keep_size;
+    freelist_header* next_node = (freelist_header*)((u8*)node + size);
+    if ((u64)next_node < freelist_range_end(allocator, node) && !FREELIST_IS_ALLOCATED(next_node)) {
+        if (tail_size == 0) {
+            return;
+        }
+        freelist_remove(allocator, next_node);
+        tail_size += FREELIST_BLOCK_SIZE(next_node);
+    } else if (tail_size < FREELIST_MIN_FREE_SIZE) {
+        freelist_mark_allocated(allocator, node);
+        return;
+    }
+
+    node->size = keep_size | (node->size & ~FREELIST_SIZE_MASK);
+    freelist_header* tail = (freelist_header*)((u8*)node + keep_size);
+    tail->size = tail_size;
+    freelist_mark_free(allocator, tail);
+    freelist_insert(allocator, tail);
+}
+
+// the tag is only 16 bits, so pointers off the 8 byte grid are turned away before the header is read
+// and a block that claims to run past the end of its range is not taken at its word
+freelist_header* freelist_validate(freelist_allocator* allocator, void* block) {
+    if (((u64)block & 7) != 0) {
+        return 0;
+    }
+    freelist_header* node = (freelist_header*)((u8*)block - FREELIST_HEADER_SIZE);
+    if (allocator->region_size) {
+        freelist_region* region = (freelist_region*)((u64)node & ~(allocator->region_size - 1));
+        if ((u64)node < (u64)region + FREELIST_REGION_HEADER_SIZE ||
+            !unordered_set_contains(allocator->region_set, &region)) {
+            return 0;
+        }
+    } else if (((u64)node < (u64)allocator->block) || ((u64)node >= ((u64)allocator->block + allocator->size))) {
+        return 0;
+    }
+    if (!FREELIST_IS_ALLOCATED(node) || FREELIST_BLOCK_SIZE(node) < FREELIST_MIN_FREE_SIZE ||
+        FREELIST_BLOCK_SIZE(node) > freelist_range_end(allocator, node) - (u64)node) {
+        return 0;
+    }
+    return node;
+}
+
+u64 freelist_required_size(u64 size) {
+    u64 required_size = ALIGN_UP(size + FREELIST_HEADER_SIZE, 8);
+    return required_size < FREELIST_MIN_FREE_SIZE ? FREELIST_MIN_FREE_SIZE : required_size;
+}
+
+// one past the last byte of the block or region node lives in, neighbours never cross it
+u64 freelist_range_end(freelist_allocator* allocator, freelist_header* node) {
+    if (allocator->region_size) {
+        return ((u64)node & ~(allocator->region_size - 1)) + allocator->region_size;
+    }
+    return (u64)allocator->block + allocator->size;
+}
+
+u64 freelist_range_largest(u8* start, u64 size) {
+    u64 largest = 0;
+    u8* end = start + size;
+    for (freelist_header* node = (freelist_header*)start; (u8*)node < end; node = (freelist_header*)((u8*)node + FREELIST_BLOCK_SIZE(node))) {
+        if (!FREELIST_IS_ALLOCATED(node) && FREELIST_BLOCK_SIZE(node) > largest) {
+            largest = FREELIST_BLOCK_SIZE(node);
+        }
+    }
+    return largest;
+}
+
+// the new region is one free block, not yet marked free nor indexed
+freelist_header* freelist_region_map(freelist_allocator* allocator) {
+    freelist_region* region = zmemory_allocate_pages_aligned(allocator->region_size, allocator->region_size);
+    if (region == 0) {
+        return 0;
+    }
+    region->next = allocator->regions;
+    region->prev = 0;
+    if (allocator->regions) {
+        allocator->regions->prev = region;
+    }
+    allocator->regions = region;
+    unordered_set_insert(allocator->region_set, &region);
+    allocator->size += allocator->capacity;
+
+    freelist_header* node = (freelist_header*)((u8*)region + FREELIST_REGION_HEADER_SIZE);
+    node->size = allocator->capacity;
+    return node;
+}
+
+// the region's free block must already be out of the index
+void freelist_region_unmap(freelist_allocator* allocator, freelist_region* region) {
+    if (region->prev) {
+        region->prev->next = region->next;
+    } else {
+        allocator->regions = region->next;
+    }
+    if (region->next) {
+        region->next->prev = region->prev;
+    }
+    unordered_set_remove(allocator->region_set, &region);
+    allocator->size -= allocator->capacity;
+    zmemory_free_pages(region, allocator->region_size);
+}
+
+freelist_header* freelist_find(freelist_allocator* allocator, u64 size) {
+    if (allocator->policy == FREELIST_ALLOCATOR_POLICY_TLSF) {
+        return freelist_tlsf_find(allocator->tlsf, size);
+    }
+    if (allocator->policy == FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE) {
+        return freelist_tree_find(allocator->root, size);
+    }
+    if (allocator->policy == FREELIST_ALLOCATOR_POLICY_FIRST_FIT) {
+        return get_first_fit_block(allocator->head, 0, size);
+    }
+    if (allocator->policy == FREELIST_ALLOCATOR_POLICY_NEXT_FIT) {
+        return get_next_fit_block(allocator, size);
+    }
+    return get_best_fit_block(allocator->head, size);
+}
+
+// a growable allocator maps a new region when no free block fits
+freelist_header* freelist_find_or_grow(freelist_allocator* allocator, u64 size) {
+    freelist_header* node = freelist_find(allocator, size);
+    if (node == 0 && allocator->region_size && size <= allocator->capacity) {
+        node = freelist_region_map(allocator);
+        if (node) {
+            freelist_mark_free(allocator, node);
+            freelist_insert(allocator, node);
+        }
+    }
+    return node;
+}
+
+bool freelist_is_huge(freelist_allocator* allocator, u64 size) {
+    return allocator->huge_threshold && size >= allocator->huge_threshold;
+}
+
+// a fixed allocator never serves more than its block, a growable one hands huge requests to the direct path
+bool freelist_size_valid(freelist_allocator* allocator, u64 size) {
+    return size != 0 && (size < allocator->capacity || (allocator->region_size && freelist_is_huge(allocator, size)));
+}
+
+void* freelist_huge_allocate(freelist_allocator* allocator, u64 size) {
+    u64 mapped_size = ALIGN_UP(size, allocator->page_size);
+    void* block = zmemory_allocate_pages(mapped_size);
+    if (block == 0) {
+        LOGW("freelist_allocator_allocate : failed to map huge block");
+        return 0;
+    }
+    zmutex_lock(&allocator->mutex);
+    freelist_huge_insert(allocator, block, mapped_size);
+    zmutex_unlock(&allocator->mutex);
+    return block;
+}
+
+void* freelist_huge_reallocate(freelist_allocator* allocator, void* block, u64 size) {
+    zmutex_lock(&allocator->mutex);
+    freelist_huge* huge = freelist_huge_find(allocator, block);
+    if (huge == 0) {
+        LOGE("freelist_allocator_reallocate : invalid block addr");
+        zmutex_unlock(&allocator->mutex);
+        return 0;
+    }
+    u64 mapped_size = huge->size;
+    if (!freelist_is_huge(allocator, size)) {
+        // small again, back onto the free blocks
+        zmutex_unlock(&allocator->mutex);
+        return freelist_reallocate_move(allocator, block, size < mapped_size ? size : mapped_size, size);
+    }
+
+    u64 new_mapped_size = ALIGN_UP(size, allocator->page_size);
+    if (new_mapped_size == mapped_size) {
+        zmutex_unlock(&allocator->mutex);
+        return block;
+    }
+    // remapped under the lock, so the table never holds an address the kernel could hand out again
+    void* moved = zmemory_reallocate_pages(block, mapped_size, new_mapped_size);
+    if (moved) {
+        freelist_huge_remove(allocator, huge);
+        freelist_huge_insert(allocator, moved, new_mapped_size);
+    }
+    zmutex_unlock(&allocator->mutex);
+    return moved;
+}
+
+void* freelist_reallocate_move(freelist_allocator* allocator, void* block, u64 copy_size, u64 size) {
+    void* moved = freelist_allocator_allocate(allocator, size);
+    if (moved == 0) {
+        return 0;
+    }
+    zmemory_copy(moved, block, copy_size < size ? copy_size : size);
+    freelist_allocator_free(allocator, block);
+    return moved;
+}
+
+u64 freelist_huge_slot(freelist_allocator* allocator, u64 address) {
+    u64 hash = (address / allocator->page_size) * 0x9E3779B97F4A7C15ull;
+    return (hash ^ (hash >> 31)) & (allocator->huge_capacity - 1);
+}
+
+freelist_huge* freelist_huge_find(freelist_allocator* allocator, void* block) {
+    // blocks from the free lists are never page aligned unless asked to be, so most frees skip the probe
+    if (allocator->huge_count == 0 || ((u64)block & (allocator->page_size - 1)) != 0) {
+        return 0;
+    }
+    u64 slot = freelist_huge_slot(allocator, (u64)block);
+    while (allocator->huge[slot].address) {
+        if (allocator->huge[slot].address == (u64)block) {
+            return &allocator->huge[slot];
+        }
+        slot = (slot + 1) & (allocator->huge_capacity - 1);
+    }
+    return 0;
+}
+
+void freelist_huge_insert(freelist_allocator* allocator, void* block, u64 size) {
+    if ((allocator->huge_count + 1) * 2 > allocator->huge_capacity) {
+        freelist_huge* old_huge = allocator->huge;
+        u64 old_capacity = allocator->huge_capacity;
+        allocator->huge_capacity = old_capacity ? old_capacity * 2 : FREELIST_HUGE_MIN_CAPACITY;
+        allocator->huge = zmemory_allocate(sizeof(freelist_huge) * allocator->huge_capacity);
+        allocator->huge_count = 0;
+        allocator->huge_used = 0;
+        for (u64 i = 0; i < old_capacity; ++i) {
+            if (old_huge[i].address) {
+                freelist_huge_insert(allocator, (void*)old_huge[i].address, old_huge[i].size);
             }
-            if (next_node->next) {
-                next_node->next->prev = next_node->prev;
+        }
+        if (old_huge) {
+            zmemory_free(old_huge, sizeof(freelist_huge) * old_capacity);
+        }
+    }
+    u64 slot = freelist_huge_slot(allocator, (u64)block);
+    while (allocator->huge[slot].address) {
+        slot = (slot + 1) & (allocator->huge_capacity - 1);
+    }
+    allocator->huge[slot].address = (u64)block;
+    allocator->huge[slot].size = size;
+    allocator->huge_count += 1;
+    allocator->huge_used += size;
+}
+
+void freelist_huge_remove(freelist_allocator* allocator, freelist_huge* entry) {
+    allocator->huge_count -= 1;
+    allocator->huge_used -= entry->size;
+    // backward shift instead of tombstones, entries further down the probe run move up into the hole
+    // unless their home slot lies past it
+    u64 mask = allocator->huge_capacity - 1;
+    u64 hole = entry - allocator->huge;
+    u64 slot = (hole + 1) & mask;
+    while (allocator->huge[slot].address) {
+        u64 home = freelist_huge_slot(allocator, allocator->huge[slot].address);
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            allocator->huge[hole] = allocator->huge[slot];
+            hole = slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    allocator->huge[hole].address = 0;
+    allocator->huge[hole].size = 0;
+}
+
+// unmaps every block on the direct path, the table keeps its slots
+void freelist_huge_release(freelist_allocator* allocator) {
+    for (u64 i = 0; i < allocator->huge_capacity; ++i) {
+        if (allocator->huge[i].address) {
+            zmemory_free_pages((void*)allocator->huge[i].address, allocator->huge[i].size);
+            allocator->huge[i].address = 0;
+            allocator->huge[i].size = 0;
+        }
+    }
+    allocator->huge_count = 0;
+    allocator->huge_used = 0;
+}
+
+void freelist_insert(freelist_allocator* allocator, freelist_header* node) {
+    if (allocator->policy == FREELIST_ALLOCATOR_POLICY_TLSF) {
+        freelist_tlsf_insert(allocator->tlsf, node);
+        return;
+    }
+    if (allocator->policy == FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE) {
+        freelist_tree_insert(allocator, node);
+        return;
+    }
+    node->prev = 0;
+    node->next = allocator->head;
+    if (allocator->head) {
+        allocator->head->prev = node;
+    }
+    allocator->head = node;
+}
+
+void freelist_remove(freelist_allocator* allocator, freelist_header* node) {
+    if (allocator->policy == FREELIST_ALLOCATOR_POLICY_TLSF) {
+        freelist_tlsf_remove(allocator->tlsf, node);
+        return;
+    }
+    if (allocator->policy == FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE) {
+        freelist_tree_remove(allocator, node);
+        return;
+    }
+    if (allocator->rover == node) {
+        allocator->rover = node->next;
+    }
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        allocator->head = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    }
+    node->next = 0;
+    node->prev = 0;
+}
+
+void freelist_tlsf_mapping(u64 size, u32* out_fl, u32* out_sl) {
+    if (size < FREELIST_TLSF_SMALL_SIZE) {
+        *out_fl = 0;
+        *out_sl = (u32)(size >> 3);
+        return;
+    }
+    u32 fl = 63 - __builtin_clzll(size);
+    *out_sl = (u32)(size >> (fl - FREELIST_TLSF_SL_SHIFT)) ^ FREELIST_TLSF_SL_COUNT;
+    *out_fl = fl - (FREELIST_TLSF_FL_SHIFT - 1);
+}
+
+freelist_header* freelist_tlsf_find(freelist_tlsf* tlsf, u64 size) {
+    // round up to the next class boundary, so every block of the class found is large enough
+    if (size >= FREELIST_TLSF_SMALL_SIZE) {
+        u32 fl = 63 - __builtin_clzll(size);
+        size += (1ull << (fl - FREELIST_TLSF_SL_SHIFT)) - 1;
+    }
+    u32 fl;
+    u32 sl;
+    freelist_tlsf_mapping(size, &fl, &sl);
+    if (fl >= FREELIST_TLSF_FL_COUNT) {
+        return 0;
+    }
+
+    u32 sl_map = tlsf->sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        // nothing left in this doubling, take the smallest non empty one above it
+        u64 fl_map = (fl + 1 < 64) ? tlsf->fl_bitmap & (~0ull << (fl + 1)) : 0;
+        if (fl_map == 0) {
+            return 0;
+        }
+        fl = __builtin_ctzll(fl_map);
+        sl_map = tlsf->sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    return tlsf->heads[fl][sl];
+}
+
+void freelist_tlsf_insert(freelist_tlsf* tlsf, freelist_header* node) {
+    u32 fl;
+    u32 sl;
+    freelist_tlsf_mapping(FREELIST_BLOCK_SIZE(node), &fl, &sl);
+    freelist_header* head = tlsf->heads[fl][sl];
+    node->prev = 0;
+    node->next = head;
+    if (head) {
+        head->prev = node;
+    }
+    tlsf->heads[fl][sl] = node;
+    tlsf->fl_bitmap |= 1ull << fl;
+    tlsf->sl_bitmap[fl] |= 1u << sl;
+}
+
+void freelist_tlsf_remove(freelist_tlsf* tlsf, freelist_header* node) {
+    u32 fl;
+    u32 sl;
+    freelist_tlsf_mapping(FREELIST_BLOCK_SIZE(node), &fl, &sl);
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        tlsf->heads[fl][sl] = node->next;
+        if (node->next == 0) {
+            tlsf->sl_bitmap[fl] &= ~(1u << sl);
+            if (tlsf->sl_bitmap[fl] == 0) {
+                tlsf->fl_bitmap &= ~(1ull << fl);
             }
+        }
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    }
+    node->next = 0;
+    node->prev = 0;
+}
+
+// the address breaks ties, so every free block has a distinct key
+bool freelist_tree_less(freelist_header* a, freelist_header* b) {
+    u64 a_size = FREELIST_BLOCK_SIZE(a);
+    u64 b_size = FREELIST_BLOCK_SIZE(b);
+    return a_size < b_size || (a_size == b_size && (u64)a < (u64)b);
+}
+
+// treap priorities are derived from the address, free blocks have no room to store one
+u64 freelist_tree_priority(freelist_header* node) {
+    u64 hash = (u64)node * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 31);
+}
 
-            next_node->prev = 0;
-            next_node->next = 0;
-            next_node->size = 0;
-            next_node->unique = 0;
-            next_node = (freelist_header*)((u8*)node + node->size);
+// leftmost block of at least size, the smallest fit at the lowest address
+freelist_header* freelist_tree_find(freelist_header* node, u64 size) {
+    freelist_header* best = 0;
+    while (node) {
+        if (FREELIST_BLOCK_SIZE(node) >= size) {
+            best = node;
+            node = node->left;
+        } else {
+            node = node->right;
         }
-        node = node->next;
     }
+    return best;
+}
+
+void freelist_tree_insert(freelist_allocator* allocator, freelist_header* node) {
+    // walk down while the parents win on priority, then split whatever hangs below by node's key
+    u64 priority = freelist_tree_priority(node);
+    freelist_header** link = &allocator->root;
+    while (*link && freelist_tree_priority(*link) > priority) {
+        link = freelist_tree_less(node, *link) ? &(*link)->left : &(*link)->right;
+    }
+    freelist_header* subtree = *link;
+    freelist_header** left = &node->left;
+    freelist_header** right = &node->right;
+    while (subtree) {
+        if (freelist_tree_less(subtree, node)) {
+            *left = subtree;
+            left = &subtree->right;
+            subtree = subtree->right;
+        } else {
+            *right = subtree;
+            right = &subtree->left;
+            subtree = subtree->left;
+        }
+    }
+    *left = 0;
+    *right = 0;
+    *link = node;
+}
 
-    unordered_set_destroy(set);
-    LOGT("freelist_allocator : coalescing completed ");
-}
\ No newline at end of file
+void freelist_tree_remove(freelist_allocator* allocator, freelist_header* node) {
+    freelist_header** link = &allocator->root;
+    while (*link != node) {
+        link = freelist_tree_less(node, *link) ? &(*link)->left : &(*link)->right;
+    }
+    // merge the two children, every key on the left is below every key on the right
+    freelist_header* left = node->left;
+    freelist_header* right = node->right;
+    while (left && right) {
+        if (freelist_tree_priority(left) > freelist_tree_priority(right)) {
+            *link = left;
+            link = &left->right;
+            left = left->right;
+        } else {
+            *link = right;
+            link = &right->left;
+            right = right->left;
+        }
+    }
+    *link = left ? left : right;
+    node->left = 0;
+    node->right = 0;
+}
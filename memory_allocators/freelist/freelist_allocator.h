@@ -3,22 +3,67 @@
 
 #include "defines.h"
 
+// how free blocks are indexed and picked
+typedef enum freelist_allocator_policy {
+    // exact best fit over one list, O(free blocks) per allocation
+    FREELIST_ALLOCATOR_POLICY_BEST_FIT = 0,
+    // two level segregated fit, bitmap scans over size classes give a good fit in O(1)
+    FREELIST_ALLOCATOR_POLICY_TLSF,
+    // exact best fit from a size ordered treap kept inside the free blocks, O(log free blocks)
+    FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE,
+    // first block of the list that fits, the list is kept most recently freed first
+    FREELIST_ALLOCATOR_POLICY_FIRST_FIT,
+    // first fit resumed where the previous search stopped, keeps walking into recently split blocks
+    FREELIST_ALLOCATOR_POLICY_NEXT_FIT,
+} freelist_allocator_policy;
+
 typedef struct freelist_allocator freelist_allocator;
 
-freelist_allocator* freelist_allocator_create(u64 size);
+// growable allocators start out mapping requests of at least this many bytes on their own pages,
+// fixed allocators start with the direct path off and only use it once a threshold is set
+#define FREELIST_ALLOCATOR_DEFAULT_HUGE_THRESHOLD (1024 * 1024)
+
+#define freelist_allocator_create(size) freelist_allocator_create_with_policy(size, FREELIST_ALLOCATOR_POLICY_BEST_FIT)
+
+freelist_allocator* freelist_allocator_create_with_policy(u64 size, freelist_allocator_policy policy);
+
+// carves the allocator out of caller owned memory, which destroy leaves alone, block must be 8 byte aligned
+freelist_allocator* freelist_allocator_create_in_place(void* block, u64 size, freelist_allocator_policy policy);
+
+// maps regions of region_size, rounded up to a power of two of pages, on demand, a region is unmapped again
+// once all its blocks are freed unless it is the last one, single allocations still have to fit one region
+freelist_allocator* freelist_allocator_create_growable(u64 region_size, freelist_allocator_policy policy);
 
 void freelist_allocator_destroy(freelist_allocator* allocator);
 
 void* freelist_allocator_allocate(freelist_allocator* allocator, u64 size);
 
+// alignment is a power of two up to the page size, the padding in front of the block stays on the free list
+void* freelist_allocator_allocate_aligned(freelist_allocator* allocator, u64 size, u64 alignment);
+
 void freelist_allocator_free(freelist_allocator* allocator, void* block);
 
+// shrinks in place, grows in place into a free next block, otherwise moves the data to a new block,
+// a null block allocates and a 0 size frees, on failure 0 is returned and block stays valid
+void* freelist_allocator_reallocate(freelist_allocator* allocator, void* block, u64 size);
+
 void freelist_allocator_reset(freelist_allocator* allocator);
 
 u64 freelist_allocator_used_memory(freelist_allocator* allocator);
 
 u64 freelist_allocator_unused_memory(freelist_allocator* allocator);
 
+// requests of at least threshold bytes skip the free blocks, each gets pages of its own that free unmaps at once
+// and reallocate resizes with mremap where available, so growing them never copies, 0 turns the direct path off,
+// a fixed allocator still rejects anything that would not fit its block, a growable one serves any size this way
+void freelist_allocator_set_huge_threshold(freelist_allocator* allocator, u64 threshold);
+
+// bytes currently mapped for blocks on the direct path, not part of used or unused memory
+u64 freelist_allocator_huge_memory(freelist_allocator* allocator);
+
 u64 freelist_allocator_header_size();
 
+// walks every block, meant for fragmentation stats rather than hot paths
+u64 freelist_allocator_largest_free_block(freelist_allocator* allocator);
+
 #endif
\ No newline at end of file
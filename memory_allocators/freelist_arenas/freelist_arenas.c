@@ -0,0 +1,129 @@
+#include "freelist_arenas.h"
+#include "zmemory.h"
+#include "logger.h"
+#include "zatomic.h"
+#include "platform.h"
+
+// one reservation split into equal power of two ranges, arena i only ever carves from range i,
+// so the arena of any block is a subtract and a shift away and blocks keep the plain freelist header
+typedef struct freelist_arenas {
+    u8* block;
+    u64 size;
+    u64 arena_size;
+    u32 arena_shift;
+    u32 arena_count;
+    freelist_allocator** arenas;
+} freelist_arenas;
+
+// tickets are handed out once per thread, ticket % arena_count picks the arena in every set
+static u64 freelist_arenas_next_ticket;
+static _Thread_local u64 thread_ticket;
+
+freelist_arenas* freelist_arenas_create(u32 arena_count, u64 arena_size, freelist_allocator_policy policy) {
+    if (arena_count == 0 || arena_size == 0) {
+        LOGE("freelist_arenas_create : invalid params");
+        return 0;
+    }
+
+    u64 rounded_arena_size = platform_page_size();
+    while (rounded_arena_size < arena_size) {
+        rounded_arena_size <<= 1;
+    }
+
+    freelist_arenas* arenas = zmemory_allocate(sizeof(freelist_arenas));
+    arenas->arena_size = rounded_arena_size;
+    arenas->arena_shift = __builtin_ctzll(rounded_arena_size);
+    arenas->arena_count = arena_count;
+    arenas->size = rounded_arena_size * arena_count;
+    arenas->block = zmemory_allocate_pages(arenas->size);
+    if (arenas->block == 0) {
+        LOGE("freelist_arenas_create : failed to allocate memory");
+        zmemory_free(arenas, sizeof(freelist_arenas));
+        return 0;
+    }
+    arenas->arenas = zmemory_allocate(sizeof(freelist_allocator*) * arena_count);
+    for (u32 i = 0; i < arena_count; ++i) {
+        arenas->arenas[i] = freelist_allocator_create_in_place(arenas->block + (u64)i * rounded_arena_size,
+                                                               rounded_arena_size, policy);
+        if (arenas->arenas[i] == 0) {
+            LOGE("freelist_arenas_create : failed to create arena %u", i);
+            freelist_arenas_destroy(arenas);
+            return 0;
+        }
+    }
+
+    LOGT("freelist_arenas_create");
+    return arenas;
+}
+
+void freelist_arenas_destroy(freelist_arenas* arenas) {
+    if (arenas == 0) {
+        LOGE("freelist_arenas_destroy : invalid params");
+        return;
+    }
+    for (u32 i = 0; i < arenas->arena_count; ++i) {
+        if (arenas->arenas[i]) {
+            freelist_allocator_destroy(arenas->arenas[i]);
+        }
+    }
+    zmemory_free(arenas->arenas, sizeof(freelist_allocator*) * arenas->arena_count);
+    zmemory_free_pages(arenas->block, arenas->size);
+    zmemory_free(arenas, sizeof(freelist_arenas));
+}
+
+void* freelist_arenas_allocate(freelist_arenas* arenas, u64 size) {
+    if (arenas == 0 || size == 0) {
+        LOGE("freelist_arenas_allocate : invalid params");
+        return 0;
+    }
+    return freelist_allocator_allocate(arenas->arenas[freelist_arenas_thread_arena(arenas)], size);
+}
+
+void freelist_arenas_free(freelist_arenas* arenas, void* block) {
+    if (arenas == 0 || block == 0) {
+        LOGE("freelist_arenas_free : invalid params");
+        return;
+    }
+    u32 index = freelist_arenas_owner(arenas, block);
+    if (index == FREELIST_ARENAS_NO_OWNER) {
+        LOGE("freelist_arenas_free : invalid memory address");
+        return;
+    }
+    // the arena checks the block is really one of its own
+    freelist_allocator_free(arenas->arenas[index], block);
+}
+
+u32 freelist_arenas_owner(freelist_arenas* arenas, void* block) {
+    if (arenas == 0 || block == 0) {
+        LOGE("freelist_arenas_owner : invalid params");
+        return FREELIST_ARENAS_NO_OWNER;
+    }
+    u64 offset = (u64)block - (u64)arenas->block;
+    if ((u64)block < (u64)arenas->block || offset >= arenas->size) {
+        return FREELIST_ARENAS_NO_OWNER;
+    }
+    return (u32)(offset >> arenas->arena_shift);
+}
+
+u32 freelist_arenas_thread_arena(freelist_arenas* arenas) {
+    if (arenas == 0) {
+        LOGE("freelist_arenas_thread_arena : invalid params");
+        return 0;
+    }
+    if (thread_ticket == 0) {
+        thread_ticket = zatomic_fetch_add(&freelist_arenas_next_ticket, 1) + 1;
+    }
+    return (u32)((thread_ticket - 1) % arenas->arena_count);
+}
+
+u64 freelist_arenas_used_memory(freelist_arenas* arenas) {
+    if (arenas == 0) {
+        LOGE("freelist_arenas_used_memory : invalid params");
+        return 0;
+    }
+    u64 used = 0;
+    for (u32 i = 0; i < arenas->arena_count; ++i) {
+        used += freelist_allocator_used_memory(arenas->arenas[i]);
+    }
+    return used;
+}
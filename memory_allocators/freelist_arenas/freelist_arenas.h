@@ -0,0 +1,36 @@
+#ifndef FREELIST_ARENAS__H
+#define FREELIST_ARENAS__H
+
+#include "defines.h"
+#include "freelist_allocator.h"
+
+// independent freelist arenas, each with its own lock, threads are spread over them round robin the first
+// time they allocate, the arenas split one reservation so a free from any thread finds the arena of its block
+// from the address alone and goes back home
+typedef struct freelist_arenas freelist_arenas;
+
+// what freelist_arenas_owner returns for a block no arena owns
+#define FREELIST_ARENAS_NO_OWNER 0xFFFFFFFFu
+
+// arena_size is rounded up to a power of two of pages, untouched pages of an arena are never faulted in
+freelist_arenas* freelist_arenas_create(u32 arena_count, u64 arena_size, freelist_allocator_policy policy);
+
+// every thread must have stopped using the arenas
+void freelist_arenas_destroy(freelist_arenas* arenas);
+
+// served by the calling thread's arena
+void* freelist_arenas_allocate(freelist_arenas* arenas, u64 size);
+
+// any thread may free any block
+void freelist_arenas_free(freelist_arenas* arenas, void* block);
+
+// index of the arena block lies in, FREELIST_ARENAS_NO_OWNER when it lies outside every arena
+u32 freelist_arenas_owner(freelist_arenas* arenas, void* block);
+
+// index of the arena the calling thread allocates from
+u32 freelist_arenas_thread_arena(freelist_arenas* arenas);
+
+// summed over every arena
+u64 freelist_arenas_used_memory(freelist_arenas* arenas);
+
+#endif
@@ -0,0 +1,174 @@
+#include "object_cache.h"
+#include "pool_allocator.h"
+#include "zmemory.h"
+#include "logger.h"
+#include "zmutex.h"
+
+#define ALIGN_UP(val, alignment) (((val) + ((alignment) - 1)) & (~((alignment) - 1)))
+#define OBJECT_CACHE_SLOT_SIZE sizeof(object_cache_slot)
+#define OBJECT_CACHE_LIVE 0xC3A5E1F7D2B49608ull
+#define OBJECT_CACHE_SLAB_CHUNKS 64
+
+// sits in front of every object so the cached list never touches constructed state
+typedef struct object_cache_slot {
+    union {
+        struct object_cache_slot* next; // while cached
+        u64 unique;                     // OBJECT_CACHE_LIVE while handed out
+    };
+} object_cache_slot;
+
+typedef struct object_cache {
+    pool_allocator* pool;
+    u64 object_size;
+    PFN_object_cache_ctor ctor;
+    PFN_object_cache_dtor dtor;
+    object_cache_slot* cached; // constructed objects ready for reuse
+    u64 cached_count;
+    u64 live_count;
+    zmutex mutex;
+} object_cache;
+
+object_cache* object_cache_create(u64 object_size, PFN_object_cache_ctor ctor, PFN_object_cache_dtor dtor) {
+    if (object_size == 0) {
+        LOGE("object_cache_create : invalid params");
+        return 0;
+    }
+
+    object_cache* cache = zmemory_allocate(sizeof(object_cache));
+    cache->object_size = object_size;
+    cache->ctor = ctor;
+    cache->dtor = dtor;
+
+    // growable so reaped slabs go back to the OS, the slot replaces the pool header
+    u64 chunk_size = OBJECT_CACHE_SLOT_SIZE + ALIGN_UP(object_size, 8);
+    cache->pool = pool_allocator_create_with_flags(chunk_size * OBJECT_CACHE_SLAB_CHUNKS, chunk_size,
+                                                   POOL_ALLOCATOR_FLAG_GROWABLE | POOL_ALLOCATOR_FLAG_NO_HEADER);
+    if (cache->pool == 0) {
+        LOGE("object_cache_create : failed to create pool");
+        zmemory_free(cache, sizeof(object_cache));
+        return 0;
+    }
+
+    if (!zmutex_create(&cache->mutex)) {
+        LOGE("object_cache_create : failed to create zmutex");
+        pool_allocator_destroy(cache->pool);
+        zmemory_free(cache, sizeof(object_cache));
+        return 0;
+    }
+
+    LOGT("object_cache_create");
+    return cache;
+}
+
+void object_cache_destroy(object_cache* cache) {
+    if (cache == 0) {
+        LOGE("object_cache_destroy : invalid params");
+        return;
+    }
+    object_cache_reap(cache);
+    if (cache->live_count) {
+        LOGW("object_cache_destroy : %llu objects still in use are released without their dtor", cache->live_count);
+    }
+    zmutex_destroy(&cache->mutex);
+    pool_allocator_destroy(cache->pool);
+    zmemory_free(cache, sizeof(object_cache));
+}
+
+void* object_cache_allocate(object_cache* cache) {
+    if (cache == 0) {
+        LOGE("object_cache_allocate : invalid params");
+        return 0;
+    }
+
+    zmutex_lock(&cache->mutex);
+    object_cache_slot* slot = cache->cached;
+    if (slot) {
+        cache->cached = slot->next;
+        cache->cached_count -= 1;
+        slot->unique = OBJECT_CACHE_LIVE;
+        cache->live_count += 1;
+        zmutex_unlock(&cache->mutex);
+        return slot + 1;
+    }
+    zmutex_unlock(&cache->mutex);
+
+    // nothing cached, build a new object outside the lock
+    slot = pool_allocator_allocate(cache->pool);
+    if (slot == 0) {
+        LOGE("object_cache_allocate : failed to allocate memory");
+        return 0;
+    }
+    if (cache->ctor && !cache->ctor(slot + 1)) {
+        LOGE("object_cache_allocate : ctor failed");
+        pool_allocator_free(cache->pool, slot);
+        return 0;
+    }
+    slot->unique = OBJECT_CACHE_LIVE;
+
+    zmutex_lock(&cache->mutex);
+    cache->live_count += 1;
+    zmutex_unlock(&cache->mutex);
+    return slot + 1;
+}
+
+void object_cache_free(object_cache* cache, void* object) {
+    if (cache == 0 || object == 0) {
+        LOGE("object_cache_free : invalid params");
+        return;
+    }
+
+    object_cache_slot* slot = (object_cache_slot*)object - 1;
+    // the pool vouches for the address before the slot is read, objects of other caches never get this far
+    if (!pool_allocator_owns(cache->pool, slot)) {
+        LOGE("object_cache_free : invalid memory address");
+        return;
+    }
+    zmutex_lock(&cache->mutex);
+    if (slot->unique != OBJECT_CACHE_LIVE) {
+        zmutex_unlock(&cache->mutex);
+        LOGE("object_cache_free : invalid memory address");
+        return;
+    }
+    // kept constructed, the dtor waits for a reap
+    slot->next = cache->cached;
+    cache->cached = slot;
+    cache->cached_count += 1;
+    cache->live_count -= 1;
+    zmutex_unlock(&cache->mutex);
+}
+
+u64 object_cache_reap(object_cache* cache) {
+    if (cache == 0) {
+        LOGE("object_cache_reap : invalid params");
+        return 0;
+    }
+
+    zmutex_lock(&cache->mutex);
+    object_cache_slot* slot = cache->cached;
+    u64 reaped = cache->cached_count;
+    cache->cached = 0;
+    cache->cached_count = 0;
+    zmutex_unlock(&cache->mutex);
+
+    while (slot) {
+        object_cache_slot* next = slot->next;
+        if (cache->dtor) {
+            cache->dtor(slot + 1);
+        }
+        // empty slabs past the pool watermark are unmapped here
+        pool_allocator_free(cache->pool, slot);
+        slot = next;
+    }
+    return reaped;
+}
+
+u64 object_cache_cached_count(object_cache* cache) {
+    if (cache == 0) {
+        LOGE("object_cache_cached_count : invalid params");
+        return 0;
+    }
+    zmutex_lock(&cache->mutex);
+    u64 count = cache->cached_count;
+    zmutex_unlock(&cache->mutex);
+    return count;
+}
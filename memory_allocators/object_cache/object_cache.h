@@ -0,0 +1,29 @@
+#ifndef OBJECT_CACHE__H
+#define OBJECT_CACHE__H
+
+#include "defines.h"
+
+// runs once when an object is first built from raw pool memory, returning false fails the allocation
+typedef bool (*PFN_object_cache_ctor)(void* object);
+// runs only when the cache gives the memory back (reap / destroy), never on object_cache_free
+typedef void (*PFN_object_cache_dtor)(void* object);
+
+typedef struct object_cache object_cache;
+
+// ctor and dtor are optional
+object_cache* object_cache_create(u64 object_size, PFN_object_cache_ctor ctor, PFN_object_cache_dtor dtor);
+
+// cached objects are destructed, objects still handed out are not
+void object_cache_destroy(object_cache* cache);
+
+// objects come back in the state they were freed in, only fresh memory goes through ctor
+void* object_cache_allocate(object_cache* cache);
+
+void object_cache_free(object_cache* cache, void* object);
+
+// destructs every cached object and hands its memory back to the pool, returns how many were reaped
+u64 object_cache_reap(object_cache* cache);
+
+u64 object_cache_cached_count(object_cache* cache);
+
+#endif
@@ -2,61 +2,308 @@
 #include "zmemory.h"
 #include "logger.h"
 #include "zmutex.h"
+#include "zatomic.h"
+#include "zthread.h"
+#include "platform.h"
+#include "unordered_set.h"
 
+#define ALIGN_UP(val, alignment) (((val) + ((alignment) - 1)) & (~((alignment) - 1)))
 #define IS_POWER_OF_TWO(val) (((val) != 0) && (((val) & ((val) - 1)) == 0))
 #define POOL_HEADER_SIZE sizeof(pool_header)
 
+// lock free head = (tag << 32) | (chunk index + 1), index 0 means empty
+#define POOL_TAGGED_INDEX_MASK 0xFFFFFFFFull
+#define POOL_TAGGED_MAX_CHUNKS 0xFFFFFFFEull
+
+#define POOL_MAGAZINE_ROUNDS 32
+#define POOL_THREAD_CACHE_SLOTS 8
+
+#define POOL_DEFAULT_SLAB_WATERMARK 1
+
+// POOL_ALLOCATOR_FLAG_CACHE_COLOR shifts each block / slab by a multiple of a cache line, at most a page apart
+#define POOL_COLOR_STRIDE 64
+
 typedef struct pool_header {
     struct pool_header* next;
     u64 unique; // 0xF7B3D591E6A4C208
 } pool_header;
 
+// sits at the start of every slab of a growable pool, slabs are aligned to their size
+typedef struct pool_slab {
+    struct pool_slab* next;
+    struct pool_slab* prev;
+    pool_header* head;
+    u64 carved;
+    u64 used;
+    u8* chunks;
+    u64* occupancy; // one bit per allocated chunk, lives right after this header
+    bool partial;   // on the allocator's partial list (has at least one free chunk)
+} pool_slab;
+
+typedef struct pool_magazine {
+    struct pool_magazine* next;
+    u64 rounds;
+    pool_header* round[POOL_MAGAZINE_ROUNDS];
+} pool_magazine;
+
+// outlives the pool while some thread still holds its magazines
+typedef struct pool_depot {
+    struct pool_allocator* allocator; // 0 once the pool is destroyed
+    pool_magazine* full;              // may also hold partially filled magazines
+    pool_magazine* empty;
+    u64 epoch;       // bumped on reset, rounds cached under an older epoch are dropped
+    u32 references;  // pool + every thread cache slot pointing here
+    zmutex mutex;
+} pool_depot;
+
+typedef struct pool_thread_cache {
+    pool_depot* depot;
+    u64 epoch;
+    pool_magazine* loaded;
+    pool_magazine* previous;
+} pool_thread_cache;
+
 typedef struct pool_allocator {
     void* block;
     u64 size;
     u64 block_size;
+    u32 block_shift; // 0 when block_size is not a power of two
+    u64 chunk_count;
+    u64 carved; // chunks below this index have been handed out at least once, the rest is untouched tail
+    u64 header_size;
+    u64* occupancy; // one bit per allocated chunk, also what pool_allocator_for_each_live walks
+    u64 occupancy_size;
+    u32* generations; // POOL_ALLOCATOR_FLAG_HANDLES only, odd while the chunk is allocated
+    u64 generations_size;
+    pool_allocator_flags flags;
     pool_header* head;
+    u64 tagged_head; // used instead of head in POOL_ALLOCATOR_FLAG_LOCK_FREE mode
+    pool_depot* depot;
+    // POOL_ALLOCATOR_FLAG_GROWABLE : size is the slab size and chunk_count the chunks per slab
+    pool_slab* partial;
+    pool_slab* full;
+    u64 slab_count;
+    u64 free_slab_count;
+    u64 slab_watermark;
+    u64 slab_chunk_offset;
+    bool external_block; // pool_allocator_create_in_place, the block belongs to the caller
+    u64 color;           // bytes between the mapping and block, or the next slab's offset when growable
+    u64 color_count;
+    u64 color_reserve; // extra bytes mapped past size to make room for the color
+    unordered_set* slabs; // slab addresses, so frees of foreign pointers never touch unmapped memory
     zmutex mutex;
 } pool_allocator;
 
-pool_allocator* pool_allocator_create(u64 size, u64 chunk_size) {
+// consecutive pools start on different colors, which is what spreads their chunk 0 over the cache sets
+static u64 pool_next_color;
+static _Thread_local pool_thread_cache thread_caches[POOL_THREAD_CACHE_SLOTS];
+static _Thread_local bool thread_caches_exit_registered;
+
+void pool_reset_freelist(pool_allocator* allocator);
+pool_header* pool_carve(pool_allocator* allocator);
+pool_header* pool_pop_locked(pool_allocator* allocator);
+void pool_push_locked(pool_allocator* allocator, pool_header* header);
+pool_header* pool_pop_lock_free(pool_allocator* allocator);
+pool_header* pool_pop(pool_allocator* allocator);
+void pool_push(pool_allocator* allocator, pool_header* header);
+u64 pool_pop_batch(pool_allocator* allocator, void** out_headers, u64 count);
+u64 pool_pop_batch_lock_free(pool_allocator* allocator, void** out_headers, u64 count);
+void pool_push_chain(pool_allocator* allocator, pool_header* first, pool_header* last);
+bool pool_chunk_in_block(pool_allocator* allocator, pool_header* header);
+u64 pool_chunk_index(pool_allocator* allocator, u64 offset);
+pool_allocator* pool_create(void* block, u64 size, u64 chunk_size, pool_allocator_flags flags);
+u64 pool_visit_live(pool_allocator* allocator, u8* chunks, u64* occupancy, u64 carved, PFN_pool_allocator_visit fn, void* ctx, bool* stop);
+u64 pool_count_live(u64* occupancy, u64 carved);
+void pool_mark_allocated(pool_allocator* allocator, pool_header* header);
+void pool_generation_bump(pool_allocator* allocator, pool_header* header);
+bool pool_generation_claim(pool_allocator* allocator, u64 index, u32 generation);
+void pool_block_free(pool_allocator* allocator);
+pool_depot* pool_depot_create(pool_allocator* allocator);
+void pool_depot_release(pool_depot* depot, pool_magazine* loaded, pool_magazine* previous);
+pool_thread_cache* pool_thread_cache_get(pool_allocator* allocator);
+void pool_thread_cache_release(pool_thread_cache* cache);
+void pool_thread_cache_exit(void* params);
+pool_header* pool_thread_cache_pop(pool_allocator* allocator);
+bool pool_thread_cache_push(pool_allocator* allocator, pool_header* header);
+bool pool_chunk_validate(pool_allocator* allocator, pool_header* header, u32 generation);
+u64* pool_occupancy_word(pool_allocator* allocator, pool_header* header, u64* out_bit);
+pool_slab* pool_slab_create(pool_allocator* allocator);
+void pool_slab_release(pool_allocator* allocator, pool_slab* slab);
+void pool_slab_unlink(pool_slab** list, pool_slab* slab);
+void pool_slab_link(pool_slab** list, pool_slab* slab);
+pool_header* pool_slab_pop(pool_allocator* allocator);
+void pool_slab_push(pool_allocator* allocator, pool_header* header);
+bool pool_slab_validate(pool_allocator* allocator, pool_header* header);
+bool pool_slab_free_locked(pool_allocator* allocator, pool_header* header);
+u64* pool_chunk_lookup(pool_allocator* allocator, pool_header* header, u64* out_bit);
+void pool_slab_reset(pool_allocator* allocator);
+
+pool_allocator* pool_allocator_create_with_flags(u64 size, u64 chunk_size, pool_allocator_flags flags) {
+    return pool_create(0, size, chunk_size, flags);
+}
+
+pool_allocator* pool_allocator_create_in_place(void* block, u64 size, u64 chunk_size, pool_allocator_flags flags) {
+    if (block == 0 || (flags & POOL_ALLOCATOR_FLAG_GROWABLE)) {
+        LOGE("pool_allocator_create_in_place : invalid params");
+        return 0;
+    }
+    return pool_create(block, size, chunk_size, flags);
+}
+
+pool_allocator* pool_create(void* block, u64 size, u64 chunk_size, pool_allocator_flags flags) {
+
+    if (flags & POOL_ALLOCATOR_FLAG_PAGE_ALIGNED) {
+        // a color or an in band header would move the chunk off its page boundary
+        u64 page_mask = platform_page_size() - 1;
+        if ((chunk_size & page_mask) != 0 || ((u64)block & page_mask) != 0 || (flags & POOL_ALLOCATOR_FLAG_CACHE_COLOR)) {
+            LOGE("pool_allocator_create : page aligned chunks need a page multiple chunk size and a page aligned block");
+            return 0;
+        }
+        flags |= POOL_ALLOCATOR_FLAG_NO_HEADER;
+    }
+
+    // without a header the chunk only has to hold the freelist link while it is free
+    u64 header_size = (flags & POOL_ALLOCATOR_FLAG_NO_HEADER) ? 0 : POOL_HEADER_SIZE;
+    u64 min_chunk_size = header_size ? header_size + 1 : sizeof(pool_header*);
 
-    if (size == 0 || chunk_size == 0 || IS_POWER_OF_TWO(chunk_size) == 0 ||
-        chunk_size <= POOL_HEADER_SIZE || size <= POOL_HEADER_SIZE) {
+    // chunks only have to keep the freelist links aligned, so any multiple of 8 works
+    if (size == 0 || chunk_size == 0 || (chunk_size & 7) != 0 ||
+        chunk_size < min_chunk_size || size < chunk_size) {
         LOGE("pool_allocator_create : invalid params");
         return 0;
     }
 
-    pool_allocator* allocator = zmemory_allocate(sizeof(pool_allocator));
-    allocator->block = zmemory_allocate(size);
-    if (allocator->block == 0) {
-        LOGE("pool_allocator_create : failed to allocate memory");
-        zmemory_free(allocator, sizeof(pool_allocator));
+    if ((flags & POOL_ALLOCATOR_FLAG_LOCK_FREE) && (size / chunk_size) > POOL_TAGGED_MAX_CHUNKS) {
+        LOGE("pool_allocator_create : too many chunks for lock free mode");
+        return 0;
+    }
+
+    // slabs are unmapped individually, which the lock free head can not follow
+    if ((flags & POOL_ALLOCATOR_FLAG_GROWABLE) && (flags & POOL_ALLOCATOR_FLAG_LOCK_FREE)) {
+        LOGE("pool_allocator_create : growable pools can not be lock free");
         return 0;
     }
-    allocator->size = size;
+
+    // a handle is a u32 chunk index into one contiguous block
+    if ((flags & POOL_ALLOCATOR_FLAG_HANDLES) &&
+        ((flags & POOL_ALLOCATOR_FLAG_GROWABLE) || (size / chunk_size) > POOL_TAGGED_MAX_CHUNKS)) {
+        LOGE("pool_allocator_create : handles need a single block of at most 2^32 - 2 chunks");
+        return 0;
+    }
+
+    pool_allocator* allocator = zmemory_allocate(sizeof(pool_allocator));
     allocator->block_size = chunk_size;
-    allocator->head = allocator->block;
-    allocator->head->next = 0;
+    allocator->block_shift = IS_POWER_OF_TWO(chunk_size) ? __builtin_ctzll(chunk_size) : 0;
+    allocator->header_size = header_size;
+    allocator->flags = flags;
+
+    if (flags & POOL_ALLOCATOR_FLAG_GROWABLE) {
+        // size is the slab size, a power of two so the owning slab is one mask away
+        u64 slab_size = platform_page_size();
+        while (slab_size < size) {
+            slab_size <<= 1;
+        }
+        u64 max_chunks = slab_size / chunk_size;
+        u64 occupancy_size = ((max_chunks + 63) >> 6) * sizeof(u64);
+        // page aligned slabs give the first page to the slab header
+        u64 chunk_alignment = (flags & POOL_ALLOCATOR_FLAG_PAGE_ALIGNED) ? platform_page_size() : 64;
+        allocator->slab_chunk_offset = ALIGN_UP(sizeof(pool_slab) + occupancy_size, chunk_alignment);
+        if (allocator->slab_chunk_offset + chunk_size > slab_size) {
+            LOGE("pool_allocator_create : slab size too small for the chunk size");
+            zmemory_free(allocator, sizeof(pool_allocator));
+            return 0;
+        }
+        allocator->size = slab_size;
+        allocator->chunk_count = (slab_size - allocator->slab_chunk_offset) / chunk_size;
+        if (flags & POOL_ALLOCATOR_FLAG_CACHE_COLOR) {
+            // slabs cycle through whatever slack the chunks leave, a power of two chunk gives up one chunk for it
+            u64 slack = slab_size - allocator->slab_chunk_offset - allocator->chunk_count * chunk_size;
+            if (slack < POOL_COLOR_STRIDE && allocator->chunk_count > 1) {
+                allocator->chunk_count -= 1;
+                slack += chunk_size;
+            }
+            allocator->color_count = slack / POOL_COLOR_STRIDE + 1;
+            if (allocator->color_count > platform_page_size() / POOL_COLOR_STRIDE) {
+                allocator->color_count = platform_page_size() / POOL_COLOR_STRIDE;
+            }
+            allocator->color = (zatomic_fetch_add(&pool_next_color, 1) % allocator->color_count) * POOL_COLOR_STRIDE;
+        }
+        allocator->slab_watermark = POOL_DEFAULT_SLAB_WATERMARK;
+        allocator->slabs = unordered_set_create(pool_slab*, 0);
+    } else {
+        u64 chunk_count = size / chunk_size;
+        if (flags & POOL_ALLOCATOR_FLAG_CACHE_COLOR) {
+            // an owned block maps one more page to shift into, a caller's block only has its slack
+            allocator->color_count = platform_page_size() / POOL_COLOR_STRIDE;
+            if (block) {
+                allocator->color_count = (size - chunk_count * chunk_size) / POOL_COLOR_STRIDE + 1;
+            } else {
+                allocator->color_reserve = platform_page_size();
+            }
+            allocator->color = (zatomic_fetch_add(&pool_next_color, 1) % allocator->color_count) * POOL_COLOR_STRIDE;
+        }
+
+        // pages are only faulted in once the tail is carved into chunks
+        allocator->block = block ? block : zmemory_allocate_pages(size + allocator->color_reserve);
+        allocator->external_block = block != 0;
+        if (allocator->block == 0) {
+            LOGE("pool_allocator_create : failed to allocate memory");
+            zmemory_free(allocator, sizeof(pool_allocator));
+            return 0;
+        }
+        allocator->block = (u8*)allocator->block + allocator->color;
+        allocator->size = block ? size - allocator->color : size;
+        allocator->chunk_count = chunk_count;
+        allocator->occupancy_size = ((allocator->chunk_count + 63) >> 6) * sizeof(u64);
+        allocator->occupancy = zmemory_allocate_pages(allocator->occupancy_size);
+        if (allocator->occupancy == 0) {
+            LOGE("pool_allocator_create : failed to allocate occupancy bitmap");
+            pool_block_free(allocator);
+            zmemory_free(allocator, sizeof(pool_allocator));
+            return 0;
+        }
+        if (flags & POOL_ALLOCATOR_FLAG_HANDLES) {
+            allocator->generations_size = allocator->chunk_count * sizeof(u32);
+            allocator->generations = zmemory_allocate_pages(allocator->generations_size);
+            if (allocator->generations == 0) {
+                LOGE("pool_allocator_create : failed to allocate generation array");
+                zmemory_free_pages(allocator->occupancy, allocator->occupancy_size);
+                pool_block_free(allocator);
+                zmemory_free(allocator, sizeof(pool_allocator));
+                return 0;
+            }
+        }
+    }
+
     if (!zmutex_create(&allocator->mutex)) {
         LOGE("pool_allocator_create : failed to create zmutex");
-        zmemory_free(allocator->block, allocator->size);
+        if (allocator->slabs) {
+            unordered_set_destroy(allocator->slabs);
+        }
+        zmemory_free_pages(allocator->occupancy, allocator->occupancy_size);
+        zmemory_free_pages(allocator->generations, allocator->generations_size);
+        pool_block_free(allocator);
         zmemory_free(allocator, sizeof(pool_allocator));
         return 0;
     }
 
-    // blocks will be aligned 8 byte by default
-    u64 block = (u64)allocator->head;
-    u64 last_addr = (u64)allocator->block + size;
-    while ((last_addr - block) > chunk_size) {
-        pool_header* addr = (pool_header*)block;
-        block += chunk_size;
-        addr->next = (pool_header*)block;
-        addr->unique = 0xF7B3D591E6A4C208;
-    }
-    pool_header* addr = (pool_header*)block;
-    addr->next = 0;
-    addr->unique = 0xF7B3D591E6A4C208;
+    if (flags & POOL_ALLOCATOR_FLAG_THREAD_CACHE) {
+        allocator->depot = pool_depot_create(allocator);
+        if (allocator->depot == 0) {
+            LOGE("pool_allocator_create : failed to create magazine depot");
+            zmutex_destroy(&allocator->mutex);
+            if (allocator->slabs) {
+                unordered_set_destroy(allocator->slabs);
+            }
+            zmemory_free_pages(allocator->occupancy, allocator->occupancy_size);
+            zmemory_free_pages(allocator->generations, allocator->generations_size);
+            pool_block_free(allocator);
+            zmemory_free(allocator, sizeof(pool_allocator));
+            return 0;
+        }
+    }
+
+    pool_reset_freelist(allocator);
 
     LOGT("pool_allocator_create");
     return allocator;
@@ -67,8 +314,31 @@ void pool_allocator_destroy(pool_allocator* allocator) {
         LOGE("pool_allocator_destroy : invalid params");
         return;
     }
+    if (allocator->depot) {
+        // other threads drop their slots on exit or when they next look for a free slot
+        for (u32 i = 0; i < POOL_THREAD_CACHE_SLOTS; ++i) {
+            if (thread_caches[i].depot == allocator->depot) {
+                pool_thread_cache_release(&thread_caches[i]);
+            }
+        }
+        zatomic_store(&allocator->depot->allocator, 0);
+        pool_depot_release(allocator->depot, 0, 0);
+    }
+    if (allocator->slabs) {
+        pool_slab* lists[2] = {allocator->partial, allocator->full};
+        for (u32 i = 0; i < 2; ++i) {
+            while (lists[i]) {
+                pool_slab* slab = lists[i];
+                lists[i] = slab->next;
+                zmemory_free_pages(slab, allocator->size);
+            }
+        }
+        unordered_set_destroy(allocator->slabs);
+    }
     zmutex_destroy(&allocator->mutex);
-    zmemory_free(allocator->block, allocator->size);
+    zmemory_free_pages(allocator->occupancy, allocator->occupancy_size);
+    zmemory_free_pages(allocator->generations, allocator->generations_size);
+    pool_block_free(allocator);
     zmemory_free(allocator, sizeof(pool_allocator));
 }
 
@@ -78,74 +348,1032 @@ void* pool_allocator_allocate(pool_allocator* allocator) {
         return 0;
     }
 
-    zmutex_lock(&allocator->mutex);
-
-    pool_header* head = allocator->head;
+    pool_header* head = 0;
+    if (allocator->flags & POOL_ALLOCATOR_FLAG_THREAD_CACHE) {
+        head = pool_thread_cache_pop(allocator);
+    }
+    if (head == 0) {
+        head = pool_pop(allocator);
+    }
 
     if (head == 0) {
         LOGW("pool_allocator_allocate : no free space");
+        return 0;
+    }
+
+    pool_mark_allocated(allocator, head);
+    return ((u8*)head + allocator->header_size); // skipping the header (if any)
+}
+
+void pool_allocator_free(pool_allocator* allocator, void* block) {
+    if (allocator == 0 || block == 0) {
+        LOGE("pool_allocator_free : invalid params");
+        return;
+    }
+
+    pool_header* remove_block = (pool_header*)((u8*)block - allocator->header_size);
+
+    if (allocator->slabs && (allocator->flags & POOL_ALLOCATOR_FLAG_THREAD_CACHE) == 0) {
+        zmutex_lock(&allocator->mutex);
+        bool freed = pool_slab_free_locked(allocator, remove_block);
         zmutex_unlock(&allocator->mutex);
+        if (!freed) {
+            LOGE("pool_allocator_free : invalid memory address");
+        }
+        return;
+    }
+
+    if (!pool_chunk_validate(allocator, remove_block, 0)) {
+        LOGE("pool_allocator_free : invalid memory address");
+        return;
+    }
+
+    if ((allocator->flags & POOL_ALLOCATOR_FLAG_THREAD_CACHE) && pool_thread_cache_push(allocator, remove_block)) {
+        return;
+    }
+    pool_push(allocator, remove_block);
+}
+
+u64 pool_allocator_allocate_batch(pool_allocator* allocator, void** out_blocks, u64 count) {
+    if (allocator == 0 || out_blocks == 0) {
+        LOGE("pool_allocator_allocate_batch : invalid params");
         return 0;
     }
 
-    allocator->head = head->next;
-    head->next = 0;
+    u64 allocated = 0;
+    if (allocator->flags & POOL_ALLOCATOR_FLAG_THREAD_CACHE) {
+        pool_header* head;
+        while (allocated < count && (head = pool_thread_cache_pop(allocator)) != 0) {
+            out_blocks[allocated++] = head;
+        }
+    }
+    allocated += pool_pop_batch(allocator, out_blocks + allocated, count - allocated);
+
+    for (u64 i = 0; i < allocated; ++i) {
+        pool_mark_allocated(allocator, out_blocks[i]);
+        out_blocks[i] = (u8*)out_blocks[i] + allocator->header_size;
+    }
+
+    if (allocated < count) {
+        LOGW("pool_allocator_allocate_batch : no free space (requested %llu, allocated %llu)", count, allocated);
+    }
+    return allocated;
+}
+
+void pool_allocator_free_batch(pool_allocator* allocator, void** blocks, u64 count) {
+    if (allocator == 0 || blocks == 0) {
+        LOGE("pool_allocator_free_batch : invalid params");
+        return;
+    }
+
+    if (allocator->slabs && (allocator->flags & POOL_ALLOCATOR_FLAG_THREAD_CACHE) == 0) {
+        // chunks go back to different slabs, but all under a single lock
+        zmutex_lock(&allocator->mutex);
+        for (u64 i = 0; i < count; ++i) {
+            pool_header* header = (pool_header*)((u8*)blocks[i] - allocator->header_size);
+            if (blocks[i] == 0 || !pool_slab_free_locked(allocator, header)) {
+                LOGE("pool_allocator_free_batch : invalid memory address");
+            }
+        }
+        zmutex_unlock(&allocator->mutex);
+        return;
+    }
+
+    // link the chunks into a private sublist and splice it in with one lock or CAS
+    pool_header* first = 0;
+    pool_header* last = 0;
+    for (u64 i = 0; i < count; ++i) {
+        pool_header* header = (pool_header*)((u8*)blocks[i] - allocator->header_size);
+        if (blocks[i] == 0 || !pool_chunk_validate(allocator, header, 0)) {
+            LOGE("pool_allocator_free_batch : invalid memory address");
+            continue;
+        }
+        if ((allocator->flags & POOL_ALLOCATOR_FLAG_THREAD_CACHE) && pool_thread_cache_push(allocator, header)) {
+            continue;
+        }
+        if (allocator->slabs) {
+            pool_push(allocator, header);
+            continue;
+        }
+        header->next = first;
+        if (last == 0) {
+            last = header;
+        }
+        first = header;
+    }
+    if (first) {
+        pool_push_chain(allocator, first, last);
+    }
+}
+
+// in lock free mode the caller must make sure no other thread is using the pool
+void pool_allocator_reset(pool_allocator* allocator) {
+    if (allocator == 0) {
+        LOGE("pool_allocator_reset : invalid params");
+        return;
+    }
+    zmutex_lock(&allocator->mutex);
+
+    if (allocator->slabs) {
+        pool_slab_reset(allocator);
+    } else {
+        // only the words covering the carved chunks can be dirty, generations are retired lazily by pool_carve
+        u64 carved = zatomic_load(&allocator->carved);
+        zmemory_set_zero(allocator->occupancy, ((carved + 63) >> 6) * sizeof(u64));
+    }
+    pool_reset_freelist(allocator);
 
     zmutex_unlock(&allocator->mutex);
 
-    return ((u8*)head + POOL_HEADER_SIZE); // adding 8 bytes to header
+    if (allocator->depot) {
+        // every chunk is on the freelist again, cached rounds must not be handed out twice
+        pool_depot* depot = allocator->depot;
+        zmutex_lock(&depot->mutex);
+        while (depot->full) {
+            pool_magazine* magazine = depot->full;
+            depot->full = magazine->next;
+            magazine->rounds = 0;
+            magazine->next = depot->empty;
+            depot->empty = magazine;
+        }
+        zatomic_fetch_add(&depot->epoch, 1);
+        zmutex_unlock(&depot->mutex);
+    }
 }
 
-void pool_allocator_free(pool_allocator* allocator, void* block) {
-    if (allocator == 0 || block == 0) {
-        LOGE("pool_allocator_free : invalid params");
+void pool_allocator_set_slab_watermark(pool_allocator* allocator, u64 free_slabs) {
+    if (allocator == 0 || allocator->slabs == 0) {
+        LOGE("pool_allocator_set_slab_watermark : invalid params");
         return;
     }
+    zmutex_lock(&allocator->mutex);
+    allocator->slab_watermark = free_slabs;
+    // trim right away, empty slabs sit on the partial list
+    pool_slab* slab = allocator->partial;
+    while (slab && allocator->free_slab_count > allocator->slab_watermark) {
+        pool_slab* next = slab->next;
+        if (slab->used == 0) {
+            pool_slab_release(allocator, slab);
+        }
+        slab = next;
+    }
+    zmutex_unlock(&allocator->mutex);
+}
 
+u64 pool_allocator_slab_count(pool_allocator* allocator) {
+    if (allocator == 0) {
+        LOGE("pool_allocator_slab_count : invalid params");
+        return 0;
+    }
+    if (allocator->slabs == 0) {
+        return 1;
+    }
     zmutex_lock(&allocator->mutex);
+    u64 count = allocator->slab_count;
+    zmutex_unlock(&allocator->mutex);
+    return count;
+}
 
-    pool_header* remove_block = (pool_header*)((u8*)block - POOL_HEADER_SIZE);
+u64 pool_allocator_header_size(pool_allocator* allocator) {
+    if (allocator == 0) {
+        LOGE("pool_allocator_header_size : invalid params");
+        return 0;
+    }
+    return allocator->header_size;
+}
 
-    if (((u64)remove_block < (u64)allocator->block) ||
-        ((u64)remove_block >= ((u64)allocator->block + allocator->size)) ||
-        remove_block->unique != 0xF7B3D591E6A4C208) {
-        LOGE("pool_allocator_free : invalid memory address");
+u64 pool_allocator_for_each_live(pool_allocator* allocator, PFN_pool_allocator_visit fn, void* ctx) {
+    if (allocator == 0 || fn == 0) {
+        LOGE("pool_allocator_for_each_live : invalid params");
+        return 0;
+    }
+    bool stop = false;
+    if (allocator->slabs == 0) {
+        return pool_visit_live(allocator, allocator->block, allocator->occupancy, zatomic_load(&allocator->carved), fn, ctx, &stop);
+    }
+    // slabs are walked in list order, chunks within a slab in address order
+    u64 visited = 0;
+    zmutex_lock(&allocator->mutex);
+    pool_slab* lists[2] = {allocator->partial, allocator->full};
+    for (u32 i = 0; i < 2 && !stop; ++i) {
+        for (pool_slab* slab = lists[i]; slab && !stop; slab = slab->next) {
+            visited += pool_visit_live(allocator, slab->chunks, slab->occupancy, slab->carved, fn, ctx, &stop);
+        }
+    }
+    zmutex_unlock(&allocator->mutex);
+    return visited;
+}
+
+bool pool_allocator_owns(pool_allocator* allocator, void* block) {
+    if (allocator == 0 || block == 0) {
+        LOGE("pool_allocator_owns : invalid params");
+        return false;
+    }
+    pool_header* header = (pool_header*)((u8*)block - allocator->header_size);
+    u64 bit;
+    if (allocator->slabs) {
+        zmutex_lock(&allocator->mutex);
+        u64* word = pool_chunk_lookup(allocator, header, &bit);
+        bool owned = word && (zatomic_load(word) & bit) != 0;
         zmutex_unlock(&allocator->mutex);
+        return owned;
+    }
+    u64* word = pool_chunk_lookup(allocator, header, &bit);
+    return word && (zatomic_load(word) & bit) != 0;
+}
+
+pool_handle pool_allocator_allocate_handle(pool_allocator* allocator) {
+    pool_handle handle = {0, 0};
+    if (allocator == 0 || allocator->generations == 0) {
+        LOGE("pool_allocator_allocate_handle : invalid params");
+        return handle;
+    }
+    void* block = pool_allocator_allocate(allocator);
+    if (block == 0) {
+        return handle;
+    }
+    handle.index = (u32)pool_chunk_index(allocator, (u64)block - allocator->header_size - (u64)allocator->block);
+    handle.generation = zatomic_load(&allocator->generations[handle.index]);
+    return handle;
+}
+
+void* pool_allocator_resolve(pool_allocator* allocator, pool_handle handle) {
+    if (allocator == 0 || allocator->generations == 0) {
+        LOGE("pool_allocator_resolve : invalid params");
+        return 0;
+    }
+    // stale and never issued handles simply resolve to nothing, the occupancy bit covers a chunk that is
+    // being carved again after a reset and has not had its generation retired yet
+    u64 bit = 1ull << (handle.index & 63);
+    if (handle.index >= zatomic_load(&allocator->carved) || (handle.generation & 1) == 0 ||
+        zatomic_load(&allocator->generations[handle.index]) != handle.generation ||
+        (zatomic_load(&allocator->occupancy[handle.index >> 6]) & bit) == 0) {
+        return 0;
+    }
+    return (u8*)allocator->block + (u64)handle.index * allocator->block_size + allocator->header_size;
+}
+
+void pool_allocator_free_handle(pool_allocator* allocator, pool_handle handle) {
+    if (allocator == 0 || allocator->generations == 0) {
+        LOGE("pool_allocator_free_handle : invalid params");
+        return;
+    }
+    if (handle.index >= zatomic_load(&allocator->carved) || (handle.generation & 1) == 0) {
+        LOGE("pool_allocator_free_handle : invalid handle");
+        return;
+    }
+    // same claim as pool_allocator_free, pinned to the handle's generation
+    pool_header* header = (pool_header*)((u8*)allocator->block + (u64)handle.index * allocator->block_size);
+    if (!pool_chunk_validate(allocator, header, handle.generation)) {
+        LOGE("pool_allocator_free_handle : stale handle");
+        return;
+    }
+    if ((allocator->flags & POOL_ALLOCATOR_FLAG_THREAD_CACHE) && pool_thread_cache_push(allocator, header)) {
         return;
     }
+    pool_push(allocator, header);
+}
 
-    pool_header* head = allocator->head;
-    allocator->head = remove_block;
-    allocator->head->next = head;
+pool_handle pool_allocator_handle_of(pool_allocator* allocator, void* block) {
+    pool_handle handle = {0, 0};
+    if (allocator == 0 || allocator->generations == 0 || block == 0) {
+        LOGE("pool_allocator_handle_of : invalid params");
+        return handle;
+    }
+    u64 offset = (u64)block - allocator->header_size - (u64)allocator->block;
+    u64 index = pool_chunk_index(allocator, offset);
+    if ((u64)block - allocator->header_size < (u64)allocator->block || index * allocator->block_size != offset ||
+        index >= zatomic_load(&allocator->carved)) {
+        LOGE("pool_allocator_handle_of : invalid memory address");
+        return handle;
+    }
+    u32 generation = zatomic_load(&allocator->generations[index]);
+    if ((generation & 1) == 0) {
+        LOGE("pool_allocator_handle_of : chunk is not allocated");
+        return handle;
+    }
+    handle.index = (u32)index;
+    handle.generation = generation;
+    return handle;
+}
 
+void pool_allocator_get_stats(pool_allocator* allocator, pool_allocator_stats* out_stats) {
+    if (allocator == 0 || out_stats == 0) {
+        LOGE("pool_allocator_get_stats : invalid params");
+        return;
+    }
+    out_stats->chunk_size = allocator->block_size;
+    out_stats->chunk_count = allocator->chunk_count;
+    out_stats->live_count = pool_allocator_live_count(allocator);
+    out_stats->slab_count = pool_allocator_slab_count(allocator);
+    out_stats->color_stride = allocator->color_count ? POOL_COLOR_STRIDE : 0;
+    out_stats->color_count = allocator->color_count;
+    zmutex_lock(&allocator->mutex);
+    out_stats->color = allocator->color;
     zmutex_unlock(&allocator->mutex);
 }
 
-void pool_allocator_reset(pool_allocator* allocator) {
+u64 pool_allocator_live_count(pool_allocator* allocator) {
     if (allocator == 0) {
-        LOGE("pool_allocator_reset : invalid params");
+        LOGE("pool_allocator_live_count : invalid params");
+        return 0;
+    }
+    // chunks parked in thread magazines are free, so count bits rather than slab->used
+    if (allocator->slabs == 0) {
+        return pool_count_live(allocator->occupancy, zatomic_load(&allocator->carved));
+    }
+    u64 count = 0;
+    zmutex_lock(&allocator->mutex);
+    pool_slab* lists[2] = {allocator->partial, allocator->full};
+    for (u32 i = 0; i < 2; ++i) {
+        for (pool_slab* slab = lists[i]; slab; slab = slab->next) {
+            count += pool_count_live(slab->occupancy, slab->carved);
+        }
+    }
+    zmutex_unlock(&allocator->mutex);
+    return count;
+}
+
+//////////////////////////////////////////////////////////////////////
+//  __                  __                                          //
+// /  |                /  |                                         //
+// $$ |____    ______  $$ |  ______    ______    ______    _______  //
+// $$      \  /      \ $$ | /      \  /      \  /      \  /       | //
+// $$$$$$$  |/$$$$$$  |$$ |/$$$$$$  |/$$$$$$  |/$$$$$$  |/$$$$$$$/  //
+// $$ |  $$ |$$    $$ |$$ |$$ |  $$ |$$    $$ |$$ |  $$/ $$      \  //
+// $$ |  $$ |$$$$$$$$/ $$ |$$ |__$$ |$$$$$$$$/ $$ |       $$$$$$  | //
+// $$ |  $$ |$$       |$$ |$$    $$/ $$       |$$ |      /     $$/  //
+// $$/   $$/  $$$$$$$/ $$/ $$$$$$$/   $$$$$$$/ $$/       $$$$$$$/   //
+//                         $$ |                                     //
+//                         $$ |                                     //
+//                         $$/                                      //
+//                                                                  //
+//////////////////////////////////////////////////////////////////////
+
+// O(1), the whole block becomes untouched tail again
+void pool_reset_freelist(pool_allocator* allocator) {
+    allocator->head = 0;
+    allocator->tagged_head = 0;
+    zatomic_store(&allocator->carved, 0);
+}
+
+// cuts the next chunk off the untouched tail, only called once the freelist is empty
+pool_header* pool_carve(pool_allocator* allocator) {
+    u64 index = zatomic_load(&allocator->carved);
+    do {
+        if (index >= allocator->chunk_count) {
+            return 0;
+        }
+    } while (!zatomic_compare_exchange(&allocator->carved, &index, index + 1));
+
+    // blocks will be aligned 8 byte by default
+    pool_header* header = (pool_header*)((u8*)allocator->block + index * allocator->block_size);
+    header->next = 0;
+    if (allocator->header_size) {
+        header->unique = 0xF7B3D591E6A4C208;
+    }
+    if (allocator->generations) {
+        // reset leaves the generations alone, a chunk that was live back then goes odd -> even here instead,
+        // which keeps reset O(1) and still makes every handle from before the reset stale
+        u32 generation = zatomic_load(&allocator->generations[index]);
+        while ((generation & 1) && !zatomic_compare_exchange(&allocator->generations[index], &generation, generation + 1)) {
+        }
+    }
+    return header;
+}
+
+// range + stride check, then the in chunk magic (if any) and the claim, which also catches double frees,
+// generation pins the claim to one allocation (0 takes whichever is live)
+bool pool_chunk_validate(pool_allocator* allocator, pool_header* header, u32 generation) {
+    if (allocator->slabs) {
+        zmutex_lock(&allocator->mutex);
+        bool valid = pool_slab_validate(allocator, header);
+        zmutex_unlock(&allocator->mutex);
+        return valid;
+    }
+    u64 offset = (u64)header - (u64)allocator->block;
+    u64 index = pool_chunk_index(allocator, offset);
+    if ((u64)header < (u64)allocator->block ||
+        index * allocator->block_size != offset ||
+        index >= zatomic_load(&allocator->carved)) {
+        return false;
+    }
+    if (allocator->header_size && header->unique != 0xF7B3D591E6A4C208) {
+        return false;
+    }
+    // with handles the generation decides which of two racing frees owns the chunk, the occupancy bit follows,
+    // pool_mark_allocated sets them in the opposite order so an odd generation always has its bit set
+    if (allocator->generations && !pool_generation_claim(allocator, index, generation)) {
+        return false;
+    }
+    u64 bit = 1ull << (index & 63);
+    return (zatomic_fetch_and(&allocator->occupancy[index >> 6], ~bit) & bit) != 0;
+}
+
+pool_header* pool_pop_locked(pool_allocator* allocator) {
+    pool_header* head = allocator->head;
+    if (head == 0) {
+        return pool_carve(allocator);
+    }
+    allocator->head = head->next;
+    head->next = 0;
+    return head;
+}
+
+void pool_push_locked(pool_allocator* allocator, pool_header* header) {
+    header->next = allocator->head;
+    allocator->head = header;
+}
+
+// treiber stack, the tag in the upper 32 bits changes on every successful swap (ABA)
+pool_header* pool_pop_lock_free(pool_allocator* allocator) {
+    u64 old_head = zatomic_load(&allocator->tagged_head);
+    while (true) {
+        u64 index = old_head & POOL_TAGGED_INDEX_MASK;
+        if (index == 0) {
+            return pool_carve(allocator);
+        }
+        pool_header* head = (pool_header*)((u8*)allocator->block + (index - 1) * allocator->block_size);
+        // chunk memory stays mapped, a stale read here only fails the swap below
+        pool_header* next = zatomic_load_relaxed(&head->next);
+        u64 next_index = next ? pool_chunk_index(allocator, (u64)next - (u64)allocator->block) + 1 : 0;
+        u64 new_head = (((old_head >> 32) + 1) << 32) | next_index;
+        if (zatomic_compare_exchange(&allocator->tagged_head, &old_head, new_head)) {
+            return head;
+        }
+    }
+}
+
+u64* pool_occupancy_word(pool_allocator* allocator, pool_header* header, u64* out_bit) {
+    u64* occupancy = allocator->occupancy;
+    u64 index;
+    if (allocator->slabs) {
+        pool_slab* slab = (pool_slab*)((u64)header & ~(allocator->size - 1));
+        occupancy = slab->occupancy;
+        index = pool_chunk_index(allocator, (u64)header - (u64)slab->chunks);
+    } else {
+        index = pool_chunk_index(allocator, (u64)header - (u64)allocator->block);
+    }
+    *out_bit = 1ull << (index & 63);
+    return &occupancy[index >> 6];
+}
+
+pool_header* pool_pop(pool_allocator* allocator) {
+    if (allocator->flags & POOL_ALLOCATOR_FLAG_LOCK_FREE) {
+        return pool_pop_lock_free(allocator);
+    }
+    zmutex_lock(&allocator->mutex);
+    pool_header* head = allocator->slabs ? pool_slab_pop(allocator) : pool_pop_locked(allocator);
+    zmutex_unlock(&allocator->mutex);
+    return head;
+}
+
+void pool_push(pool_allocator* allocator, pool_header* header) {
+    if (allocator->flags & POOL_ALLOCATOR_FLAG_LOCK_FREE) {
+        pool_push_chain(allocator, header, header);
         return;
     }
     zmutex_lock(&allocator->mutex);
+    if (allocator->slabs) {
+        pool_slab_push(allocator, header);
+    } else {
+        pool_push_locked(allocator, header);
+    }
+    zmutex_unlock(&allocator->mutex);
+}
 
-    allocator->head = allocator->block;
-    allocator->head->next = 0;
+u64 pool_pop_batch(pool_allocator* allocator, void** out_headers, u64 count) {
+    if (allocator->flags & POOL_ALLOCATOR_FLAG_LOCK_FREE) {
+        return pool_pop_batch_lock_free(allocator, out_headers, count);
+    }
+    u64 popped = 0;
+    zmutex_lock(&allocator->mutex);
+    while (popped < count) {
+        pool_header* head = allocator->slabs ? pool_slab_pop(allocator) : pool_pop_locked(allocator);
+        if (head == 0) {
+            break;
+        }
+        out_headers[popped++] = head;
+    }
+    zmutex_unlock(&allocator->mutex);
+    return popped;
+}
 
-    u64 block = (u64)allocator->head;
-    u64 last_addr = (u64)allocator->block + allocator->size;
-    while ((last_addr - block) > allocator->block_size) {
-        pool_header* addr = (pool_header*)block;
-        block += allocator->block_size;
-        addr->next = (pool_header*)block;
-        addr->unique = 0xF7B3D591E6A4C208;
+// detaches up to count chunks from the tagged head with a single CAS, the rest is carved
+u64 pool_pop_batch_lock_free(pool_allocator* allocator, void** out_headers, u64 count) {
+    u64 popped = 0;
+    u64 old_head = zatomic_load(&allocator->tagged_head);
+    while (count) {
+        u64 index = old_head & POOL_TAGGED_INDEX_MASK;
+        if (index == 0) {
+            break;
+        }
+        pool_header* first = (pool_header*)((u8*)allocator->block + (index - 1) * allocator->block_size);
+        pool_header* last = first;
+        u64 taken = 1;
+        // links may be torn by concurrent pops, so only follow ones that point into the block
+        pool_header* next = zatomic_load_relaxed(&last->next);
+        while (taken < count && next && pool_chunk_in_block(allocator, next)) {
+            last = next;
+            taken += 1;
+            next = zatomic_load_relaxed(&last->next);
+        }
+        if (next && !pool_chunk_in_block(allocator, next)) {
+            old_head = zatomic_load(&allocator->tagged_head);
+            continue;
+        }
+        u64 next_index = next ? pool_chunk_index(allocator, (u64)next - (u64)allocator->block) + 1 : 0;
+        u64 new_head = (((old_head >> 32) + 1) << 32) | next_index;
+        if (zatomic_compare_exchange(&allocator->tagged_head, &old_head, new_head)) {
+            // the tag did not move, so the walked sublist was intact and is now ours
+            pool_header* node = first;
+            for (u64 i = 0; i < taken; ++i) {
+                out_headers[popped++] = node;
+                node = node->next;
+            }
+            break;
+        }
     }
-    pool_header* addr = (pool_header*)block;
-    addr->next = 0;
-    addr->unique = 0xF7B3D591E6A4C208;
+    while (popped < count) {
+        pool_header* head = pool_carve(allocator);
+        if (head == 0) {
+            break;
+        }
+        out_headers[popped++] = head;
+    }
+    return popped;
+}
 
+void pool_push_chain(pool_allocator* allocator, pool_header* first, pool_header* last) {
+    if (allocator->flags & POOL_ALLOCATOR_FLAG_LOCK_FREE) {
+        u64 index = pool_chunk_index(allocator, (u64)first - (u64)allocator->block) + 1;
+        u64 old_head = zatomic_load(&allocator->tagged_head);
+        u64 new_head;
+        do {
+            u64 head_index = old_head & POOL_TAGGED_INDEX_MASK;
+            pool_header* next = head_index ? (pool_header*)((u8*)allocator->block + (head_index - 1) * allocator->block_size) : 0;
+            zatomic_store(&last->next, next);
+            new_head = (((old_head >> 32) + 1) << 32) | index;
+        } while (!zatomic_compare_exchange(&allocator->tagged_head, &old_head, new_head));
+        return;
+    }
+    zmutex_lock(&allocator->mutex);
+    last->next = allocator->head;
+    allocator->head = first;
     zmutex_unlock(&allocator->mutex);
 }
 
-u64 pool_allocator_header_size() {
-    return POOL_HEADER_SIZE;
+bool pool_chunk_in_block(pool_allocator* allocator, pool_header* header) {
+    u64 offset = (u64)header - (u64)allocator->block;
+    return (u64)header >= (u64)allocator->block && offset < allocator->size &&
+           pool_chunk_index(allocator, offset) * allocator->block_size == offset;
+}
+
+// empty 64 chunk groups cost one load, set bits are peeled off lowest first so chunks come in address order
+u64 pool_visit_live(pool_allocator* allocator, u8* chunks, u64* occupancy, u64 carved, PFN_pool_allocator_visit fn, void* ctx, bool* stop) {
+    u64 visited = 0;
+    u64 words = (carved + 63) >> 6;
+    for (u64 i = 0; i < words; ++i) {
+        u64 word = zatomic_load_relaxed(&occupancy[i]);
+        while (word) {
+            u64 index = (i << 6) + __builtin_ctzll(word);
+            word &= word - 1;
+            visited += 1;
+            if (!fn(chunks + index * allocator->block_size + allocator->header_size, ctx)) {
+                *stop = true;
+                return visited;
+            }
+        }
+    }
+    return visited;
+}
+
+u64 pool_count_live(u64* occupancy, u64 carved) {
+    u64 count = 0;
+    u64 words = (carved + 63) >> 6;
+    for (u64 i = 0; i < words; ++i) {
+        count += __builtin_popcountll(zatomic_load_relaxed(&occupancy[i]));
+    }
+    return count;
+}
+
+void pool_mark_allocated(pool_allocator* allocator, pool_header* header) {
+    u64 bit;
+    u64* word = pool_occupancy_word(allocator, header, &bit);
+    zatomic_fetch_or(word, bit);
+    // even -> odd, handles taken from now on resolve
+    pool_generation_bump(allocator, header);
+}
+
+void pool_generation_bump(pool_allocator* allocator, pool_header* header) {
+    if (allocator->generations) {
+        u64 index = pool_chunk_index(allocator, (u64)header - (u64)allocator->block);
+        zatomic_fetch_add(&allocator->generations[index], 1);
+    }
+}
+
+// odd -> even, only one of several frees of the same allocation gets to move the generation on
+bool pool_generation_claim(pool_allocator* allocator, u64 index, u32 generation) {
+    u32 expected = generation ? generation : zatomic_load(&allocator->generations[index]);
+    while ((expected & 1) && (generation == 0 || expected == generation)) {
+        if (zatomic_compare_exchange(&allocator->generations[index], &expected, expected + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void pool_block_free(pool_allocator* allocator) {
+    // growable pools have no block, their slabs are unmapped one by one
+    if (allocator->block && !allocator->external_block) {
+        zmemory_free_pages((u8*)allocator->block - allocator->color, allocator->size + allocator->color_reserve);
+    }
+}
+
+u64 pool_chunk_index(pool_allocator* allocator, u64 offset) {
+    // power of two chunks skip the division
+    return allocator->block_shift ? offset >> allocator->block_shift : offset / allocator->block_size;
+}
+
+pool_slab* pool_slab_create(pool_allocator* allocator) {
+    pool_slab* slab = zmemory_allocate_pages_aligned(allocator->size, allocator->size);
+    if (slab == 0) {
+        return 0;
+    }
+    slab->chunks = (u8*)slab + allocator->slab_chunk_offset + allocator->color;
+    if (allocator->color_count) {
+        allocator->color = (allocator->color + POOL_COLOR_STRIDE) % (allocator->color_count * POOL_COLOR_STRIDE);
+    }
+    slab->occupancy = (u64*)(slab + 1);
+    unordered_set_insert(allocator->slabs, &slab);
+    pool_slab_link(&allocator->partial, slab);
+    slab->partial = true;
+    allocator->slab_count += 1;
+    allocator->free_slab_count += 1;
+    return slab;
+}
+
+// slab must be empty and on the partial list
+void pool_slab_release(pool_allocator* allocator, pool_slab* slab) {
+    pool_slab_unlink(&allocator->partial, slab);
+    unordered_set_remove(allocator->slabs, &slab);
+    allocator->slab_count -= 1;
+    allocator->free_slab_count -= 1;
+    zmemory_free_pages(slab, allocator->size);
+}
+
+void pool_slab_unlink(pool_slab** list, pool_slab* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = 0;
+    slab->prev = 0;
+}
+
+void pool_slab_link(pool_slab** list, pool_slab* slab) {
+    slab->prev = 0;
+    slab->next = *list;
+    if (*list) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+pool_header* pool_slab_pop(pool_allocator* allocator) {
+    pool_slab* slab = allocator->partial;
+    if (slab == 0) {
+        slab = pool_slab_create(allocator);
+        if (slab == 0) {
+            return 0;
+        }
+    }
+
+    pool_header* header = slab->head;
+    if (header) {
+        slab->head = header->next;
+    } else {
+        header = (pool_header*)(slab->chunks + slab->carved * allocator->block_size);
+        slab->carved += 1;
+        if (allocator->header_size) {
+            header->unique = 0xF7B3D591E6A4C208;
+        }
+    }
+    header->next = 0;
+
+    if (slab->used == 0) {
+        allocator->free_slab_count -= 1;
+    }
+    slab->used += 1;
+    if (slab->used == allocator->chunk_count) {
+        pool_slab_unlink(&allocator->partial, slab);
+        pool_slab_link(&allocator->full, slab);
+        slab->partial = false;
+    }
+    return header;
+}
+
+void pool_slab_push(pool_allocator* allocator, pool_header* header) {
+    pool_slab* slab = (pool_slab*)((u64)header & ~(allocator->size - 1));
+
+    header->next = slab->head;
+    slab->head = header;
+
+    if (!slab->partial) {
+        pool_slab_unlink(&allocator->full, slab);
+        pool_slab_link(&allocator->partial, slab);
+        slab->partial = true;
+    }
+    slab->used -= 1;
+    if (slab->used == 0) {
+        allocator->free_slab_count += 1;
+        if (allocator->free_slab_count > allocator->slab_watermark) {
+            pool_slab_release(allocator, slab);
+        }
+    }
+}
+
+bool pool_slab_validate(pool_allocator* allocator, pool_header* header) {
+    u64 bit;
+    u64* word = pool_chunk_lookup(allocator, header, &bit);
+    if (word == 0) {
+        return false;
+    }
+    if (allocator->header_size && header->unique != 0xF7B3D591E6A4C208) {
+        return false;
+    }
+    return (zatomic_fetch_and(word, ~bit) & bit) != 0;
+}
+
+// validation and push in the caller's critical section, so the slab can not change in between
+bool pool_slab_free_locked(pool_allocator* allocator, pool_header* header) {
+    if (!pool_slab_validate(allocator, header)) {
+        return false;
+    }
+    pool_slab_push(allocator, header);
+    return true;
+}
+
+// range + stride check against the block or the slab registry, nothing is read from the chunk itself,
+// 0 when header is not a carved chunk of this pool (growable pools must hold the mutex)
+u64* pool_chunk_lookup(pool_allocator* allocator, pool_header* header, u64* out_bit) {
+    u8* chunks = allocator->block;
+    u64* occupancy = allocator->occupancy;
+    u64 carved;
+    if (allocator->slabs) {
+        pool_slab* slab = (pool_slab*)((u64)header & ~(allocator->size - 1));
+        if (!unordered_set_contains(allocator->slabs, &slab)) {
+            return 0;
+        }
+        chunks = slab->chunks;
+        occupancy = slab->occupancy;
+        carved = slab->carved;
+    } else {
+        carved = zatomic_load(&allocator->carved);
+    }
+    u64 offset = (u64)header - (u64)chunks;
+    u64 index = pool_chunk_index(allocator, offset);
+    if ((u64)header < (u64)chunks || index * allocator->block_size != offset || index >= carved) {
+        return 0;
+    }
+    *out_bit = 1ull << (index & 63);
+    return &occupancy[index >> 6];
+}
+
+// every slab becomes untouched again, the ones past the watermark are unmapped
+void pool_slab_reset(pool_allocator* allocator) {
+    while (allocator->full) {
+        pool_slab* slab = allocator->full;
+        pool_slab_unlink(&allocator->full, slab);
+        pool_slab_link(&allocator->partial, slab);
+        slab->partial = true;
+    }
+    allocator->free_slab_count = allocator->slab_count;
+
+    pool_slab* slab = allocator->partial;
+    while (slab) {
+        pool_slab* next = slab->next;
+        if (allocator->free_slab_count > allocator->slab_watermark) {
+            slab->used = 0;
+            pool_slab_release(allocator, slab);
+        } else {
+            zmemory_set_zero(slab->occupancy, ((slab->carved + 63) >> 6) * sizeof(u64));
+            slab->head = 0;
+            slab->carved = 0;
+            slab->used = 0;
+        }
+        slab = next;
+    }
+}
+
+pool_depot* pool_depot_create(pool_allocator* allocator) {
+    pool_depot* depot = zmemory_allocate(sizeof(pool_depot));
+    if (depot == 0) {
+        return 0;
+    }
+    if (!zmutex_create(&depot->mutex)) {
+        zmemory_free(depot, sizeof(pool_depot));
+        return 0;
+    }
+    depot->allocator = allocator;
+    depot->references = 1;
+    return depot;
+}
+
+// hands the magazines back (or frees them if the pool is gone) and drops one reference
+void pool_depot_release(pool_depot* depot, pool_magazine* loaded, pool_magazine* previous) {
+    pool_magazine* magazines[2] = {loaded, previous};
+    pool_magazine* dead = 0;
+
+    zmutex_lock(&depot->mutex);
+    for (u32 i = 0; i < 2; ++i) {
+        pool_magazine* magazine = magazines[i];
+        if (magazine == 0) {
+            continue;
+        }
+        if (depot->allocator == 0) {
+            magazine->next = dead;
+            dead = magazine;
+        } else if (magazine->rounds) {
+            magazine->next = depot->full;
+            depot->full = magazine;
+        } else {
+            magazine->next = depot->empty;
+            depot->empty = magazine;
+        }
+    }
+    depot->references -= 1;
+    bool last = depot->references == 0;
+    if (last) {
+        pool_magazine* lists[2] = {depot->full, depot->empty};
+        for (u32 i = 0; i < 2; ++i) {
+            while (lists[i]) {
+                pool_magazine* magazine = lists[i];
+                lists[i] = magazine->next;
+                magazine->next = dead;
+                dead = magazine;
+            }
+        }
+    }
+    zmutex_unlock(&depot->mutex);
+
+    while (dead) {
+        pool_magazine* magazine = dead;
+        dead = magazine->next;
+        zmemory_free(magazine, sizeof(pool_magazine));
+    }
+    if (last) {
+        zmutex_destroy(&depot->mutex);
+        zmemory_free(depot, sizeof(pool_depot));
+    }
+}
+
+pool_thread_cache* pool_thread_cache_get(pool_allocator* allocator) {
+    pool_depot* depot = allocator->depot;
+    pool_thread_cache* unused = 0;
+
+    for (u32 i = 0; i < POOL_THREAD_CACHE_SLOTS; ++i) {
+        pool_thread_cache* cache = &thread_caches[i];
+        if (cache->depot == depot) {
+            u64 epoch = zatomic_load(&depot->epoch);
+            if (cache->epoch != epoch) {
+                // the pool was reset, these rounds are already back on its freelist
+                cache->loaded->rounds = 0;
+                cache->previous->rounds = 0;
+                cache->epoch = epoch;
+            }
+            return cache;
+        }
+        if (cache->depot && zatomic_load(&cache->depot->allocator) == 0) {
+            pool_thread_cache_release(cache);
+        }
+        if (cache->depot == 0 && unused == 0) {
+            unused = cache;
+        }
+    }
+
+    if (unused == 0) {
+        // too many pools on this thread, fall back to the shared freelist
+        return 0;
+    }
+
+    if (!thread_caches_exit_registered) {
+        thread_caches_exit_registered = zthread_register_exit_callback(pool_thread_cache_exit, 0);
+    }
+
+    pool_magazine* magazines[2] = {0, 0};
+    zmutex_lock(&depot->mutex);
+    for (u32 i = 0; i < 2 && depot->empty; ++i) {
+        magazines[i] = depot->empty;
+        depot->empty = magazines[i]->next;
+    }
+    depot->references += 1;
+    unused->epoch = depot->epoch;
+    zmutex_unlock(&depot->mutex);
+
+    for (u32 i = 0; i < 2; ++i) {
+        if (magazines[i] == 0) {
+            magazines[i] = zmemory_allocate(sizeof(pool_magazine));
+        }
+    }
+    if (magazines[0] == 0 || magazines[1] == 0) {
+        pool_depot_release(depot, magazines[0], magazines[1]);
+        return 0;
+    }
+    unused->depot = depot;
+    unused->loaded = magazines[0];
+    unused->previous = magazines[1];
+    return unused;
+}
+
+void pool_thread_cache_release(pool_thread_cache* cache) {
+    pool_depot_release(cache->depot, cache->loaded, cache->previous);
+    cache->depot = 0;
+    cache->epoch = 0;
+    cache->loaded = 0;
+    cache->previous = 0;
+}
+
+void pool_thread_cache_exit(void* params) {
+    (void)params;
+    for (u32 i = 0; i < POOL_THREAD_CACHE_SLOTS; ++i) {
+        if (thread_caches[i].depot) {
+            pool_thread_cache_release(&thread_caches[i]);
+        }
+    }
+    thread_caches_exit_registered = false;
+}
+
+// bonwick's magazine layer : loaded -> previous -> depot full list
+pool_header* pool_thread_cache_pop(pool_allocator* allocator) {
+    pool_thread_cache* cache = pool_thread_cache_get(allocator);
+    if (cache == 0) {
+        return 0;
+    }
+
+    if (cache->loaded->rounds == 0) {
+        if (cache->previous->rounds == 0) {
+            pool_depot* depot = cache->depot;
+            zmutex_lock(&depot->mutex);
+            pool_magazine* full = depot->full;
+            if (full == 0) {
+                zmutex_unlock(&depot->mutex);
+                return 0;
+            }
+            depot->full = full->next;
+            cache->previous->next = depot->empty;
+            depot->empty = cache->previous;
+            zmutex_unlock(&depot->mutex);
+            cache->previous = full;
+        }
+        pool_magazine* temp = cache->loaded;
+        cache->loaded = cache->previous;
+        cache->previous = temp;
+    }
+
+    cache->loaded->rounds -= 1;
+    return cache->loaded->round[cache->loaded->rounds];
+}
+
+// returns false when the chunk has to go to the shared freelist instead
+bool pool_thread_cache_push(pool_allocator* allocator, pool_header* header) {
+    pool_thread_cache* cache = pool_thread_cache_get(allocator);
+    if (cache == 0) {
+        return false;
+    }
+
+    if (cache->loaded->rounds == POOL_MAGAZINE_ROUNDS) {
+        if (cache->previous->rounds == POOL_MAGAZINE_ROUNDS) {
+            pool_depot* depot = cache->depot;
+            zmutex_lock(&depot->mutex);
+            pool_magazine* empty = depot->empty;
+            if (empty) {
+                depot->empty = empty->next;
+            }
+            zmutex_unlock(&depot->mutex);
+            if (empty == 0) {
+                empty = zmemory_allocate(sizeof(pool_magazine));
+                if (empty == 0) {
+                    return false;
+                }
+            }
+            zmutex_lock(&depot->mutex);
+            cache->previous->next = depot->full;
+            depot->full = cache->previous;
+            zmutex_unlock(&depot->mutex);
+            empty->rounds = 0;
+            cache->previous = empty;
+        }
+        pool_magazine* temp = cache->loaded;
+        cache->loaded = cache->previous;
+        cache->previous = temp;
+    }
+
+    cache->loaded->round[cache->loaded->rounds] = header;
+    cache->loaded->rounds += 1;
+    return true;
 }
@@ -3,9 +3,54 @@
 
 #include "defines.h"
 
+typedef enum pool_allocator_flags {
+    POOL_ALLOCATOR_FLAG_NONE = 0,
+    // allocate/free use a CAS on a tagged head instead of the zmutex
+    POOL_ALLOCATOR_FLAG_LOCK_FREE = 1 << 0,
+    // per thread magazines in front of the freelist, drained to a shared depot on zthread exit
+    POOL_ALLOCATOR_FLAG_THREAD_CACHE = 1 << 1,
+    // no in chunk header, frees are only checked against the occupancy bitmap
+    POOL_ALLOCATOR_FLAG_NO_HEADER = 1 << 2,
+    // size becomes the slab size, new slabs are chained when the pool runs dry (not with LOCK_FREE)
+    POOL_ALLOCATOR_FLAG_GROWABLE = 1 << 3,
+    // side generation array for the pool_handle api, combine with NO_HEADER to drop the in chunk magic (not with GROWABLE)
+    POOL_ALLOCATOR_FLAG_HANDLES = 1 << 4,
+    // every block / slab starts a cache line further than the last one so chunk 0 of each lands on different sets
+    POOL_ALLOCATOR_FLAG_CACHE_COLOR = 1 << 5,
+    // direct I/O buffers, every chunk starts on a page boundary, chunk_size must be a multiple of the page size,
+    // implies NO_HEADER (not with CACHE_COLOR)
+    POOL_ALLOCATOR_FLAG_PAGE_ALIGNED = 1 << 6,
+} pool_allocator_flags;
+
 typedef struct pool_allocator pool_allocator;
 
-pool_allocator* pool_allocator_create(u64 size, u64 chunk_size);
+// generation is odd while the chunk is allocated, so a zeroed handle never resolves
+typedef struct pool_handle {
+    u32 index;
+    u32 generation;
+} pool_handle;
+
+typedef struct pool_allocator_stats {
+    u64 chunk_size;
+    u64 chunk_count; // per slab for growable pools
+    u64 live_count;
+    u64 slab_count;
+    u64 color_stride; // bytes between two colors, 0 without POOL_ALLOCATOR_FLAG_CACHE_COLOR
+    u64 color_count;  // starting offsets cycled through
+    u64 color;        // offset of the block, or of the next slab for growable pools
+} pool_allocator_stats;
+
+// return false to stop the walk
+typedef bool (*PFN_pool_allocator_visit)(void* block, void* ctx);
+
+#define pool_allocator_create(size, chunk_size) pool_allocator_create_with_flags(size, chunk_size, POOL_ALLOCATOR_FLAG_NONE)
+
+// chunk_size must be a multiple of 8, powers of two keep the index math to shifts
+pool_allocator* pool_allocator_create_with_flags(u64 size, u64 chunk_size, pool_allocator_flags flags);
+
+// carves the pool out of caller owned memory, which destroy leaves alone (not with GROWABLE),
+// the block must be page aligned for POOL_ALLOCATOR_FLAG_PAGE_ALIGNED
+pool_allocator* pool_allocator_create_in_place(void* block, u64 size, u64 chunk_size, pool_allocator_flags flags);
 
 void pool_allocator_destroy(pool_allocator* allocator);
 
@@ -13,8 +58,45 @@ void* pool_allocator_allocate(pool_allocator* allocator);
 
 void pool_allocator_free(pool_allocator* allocator, void* block_addr);
 
+// returns how many chunks were written to out_blocks, fewer than count once the pool runs dry
+u64 pool_allocator_allocate_batch(pool_allocator* allocator, void** out_blocks, u64 count);
+
+void pool_allocator_free_batch(pool_allocator* allocator, void** blocks, u64 count);
+
+// O(1) apart from clearing one occupancy word per 64 carved chunks, handles taken before the reset go stale
+// as their chunks are carved again
 void pool_allocator_reset(pool_allocator* allocator);
 
-u64 pool_allocator_header_size();
+// growable pools keep at most this many completely free slabs, the rest go back to the OS
+void pool_allocator_set_slab_watermark(pool_allocator* allocator, u64 free_slabs);
+
+u64 pool_allocator_slab_count(pool_allocator* allocator);
+
+// bytes reserved in front of every chunk, 0 for POOL_ALLOCATOR_FLAG_NO_HEADER
+u64 pool_allocator_header_size(pool_allocator* allocator);
+
+// visits every allocated chunk in address order (per slab for growable pools) and returns how many were visited,
+// fn must not allocate from or free to the pool, collect and free after the walk instead
+u64 pool_allocator_for_each_live(pool_allocator* allocator, PFN_pool_allocator_visit fn, void* ctx);
+
+u64 pool_allocator_live_count(pool_allocator* allocator);
+
+// true when block is a chunk this pool handed out and has not taken back, decided from the address and the
+// occupancy bitmap alone so foreign pointers are never dereferenced
+bool pool_allocator_owns(pool_allocator* allocator, void* block);
+
+void pool_allocator_get_stats(pool_allocator* allocator, pool_allocator_stats* out_stats);
+
+// POOL_ALLOCATOR_FLAG_HANDLES only, a failed allocation returns the zeroed handle
+pool_handle pool_allocator_allocate_handle(pool_allocator* allocator);
+
+// O(1), returns 0 once the chunk was freed (and possibly reused) since the handle was taken
+void* pool_allocator_resolve(pool_allocator* allocator, pool_handle handle);
+
+// stale handles are rejected instead of freeing whoever owns the chunk now
+void pool_allocator_free_handle(pool_allocator* allocator, pool_handle handle);
+
+// handle for a block from pool_allocator_allocate
+pool_handle pool_allocator_handle_of(pool_allocator* allocator, void* block);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,315 @@
+#include "sharded_pool.h"
+#include "zmemory.h"
+#include "logger.h"
+#include "zatomic.h"
+#include "platform.h"
+#include "zthread.h"
+
+#define SHARDED_POOL_HEADER_SIZE sizeof(sharded_pool_header)
+#define SHARDED_POOL_THREAD_SLOTS 8
+#define SHARDED_POOL_CACHE_LINE 64
+
+#define SHARDED_POOL_MAGIC 0xF7B3D591E6A4C208ull
+
+typedef struct sharded_pool_header {
+    struct sharded_pool_header* next;
+    u64 unique; // SHARDED_POOL_MAGIC while allocated, 0 while on a free list
+} sharded_pool_header;
+
+typedef struct sharded_pool_shard {
+    // owner side, head and carved are only written by the owning thread
+    u64 owner; // id of the owning thread, 0 while unclaimed
+    sharded_pool_header* head;
+    u64 carved;
+    u8* chunks;
+    // remote side on its own cache line, cross thread frees never touch the owner's line
+    _Alignas(SHARDED_POOL_CACHE_LINE) sharded_pool_header* remote_head;
+} sharded_pool_shard;
+
+// outlives the pool while some thread slot still points at one of its shards, so a thread that exits
+// after the pool was destroyed only ever hands its shard back to mapped memory
+typedef struct sharded_pool_shards {
+    u32 references; // pool + every thread slot pointing here
+    bool alive;     // false once the pool is destroyed
+    u64 size;
+    sharded_pool_shard shard[];
+} sharded_pool_shards;
+
+typedef struct sharded_pool {
+    u8* block;
+    u64 size;
+    u64 shard_size;
+    u32 shard_shift;
+    u32 shard_count;
+    u64 chunk_size;
+    u64 chunk_count; // per shard
+    sharded_pool_shards* shards;
+} sharded_pool;
+
+// which shard the calling thread owns in each pool it has touched
+typedef struct sharded_pool_slot {
+    sharded_pool_shards* shards; // holds a reference, so the address can not be recycled while it sits here
+    sharded_pool_shard* shard;
+} sharded_pool_slot;
+
+static u64 sharded_pool_next_thread_id;
+static _Thread_local u64 thread_id;
+static _Thread_local sharded_pool_slot thread_slots[SHARDED_POOL_THREAD_SLOTS];
+static _Thread_local u32 thread_slot_victim;
+static _Thread_local bool thread_slots_exit_registered;
+
+u64 sharded_pool_thread_id();
+sharded_pool_shard* sharded_pool_shard_get(sharded_pool* pool);
+sharded_pool_shard* sharded_pool_shard_of(sharded_pool* pool, sharded_pool_header* header);
+void sharded_pool_slot_release(sharded_pool_slot* slot);
+void sharded_pool_shards_release(sharded_pool_shards* shards);
+void sharded_pool_thread_exit(void* params);
+
+sharded_pool* sharded_pool_create(u32 shard_count, u64 shard_size, u64 chunk_size) {
+    u64 rounded_shard_size = platform_page_size();
+    while (rounded_shard_size < shard_size) {
+        rounded_shard_size <<= 1;
+    }
+
+    if (shard_count == 0 || shard_size == 0 || chunk_size <= SHARDED_POOL_HEADER_SIZE || (chunk_size & 7) != 0 ||
+        rounded_shard_size < chunk_size) {
+        LOGE("sharded_pool_create : invalid params");
+        return 0;
+    }
+
+    sharded_pool* pool = zmemory_allocate(sizeof(sharded_pool));
+    pool->shard_size = rounded_shard_size;
+    pool->shard_shift = __builtin_ctzll(pool->shard_size);
+    pool->shard_count = shard_count;
+    pool->chunk_size = chunk_size;
+    pool->chunk_count = pool->shard_size / chunk_size;
+
+    // pages are only faulted in once a shard carves into them
+    pool->size = pool->shard_size * shard_count;
+    pool->block = zmemory_allocate_pages(pool->size);
+    if (pool->block == 0) {
+        LOGE("sharded_pool_create : failed to allocate memory");
+        zmemory_free(pool, sizeof(sharded_pool));
+        return 0;
+    }
+
+    // page aligned, so every shard starts on its own cache line
+    u64 shards_size = sizeof(sharded_pool_shards) + sizeof(sharded_pool_shard) * shard_count;
+    pool->shards = zmemory_allocate_pages(shards_size);
+    if (pool->shards == 0) {
+        LOGE("sharded_pool_create : failed to allocate shards");
+        zmemory_free_pages(pool->block, pool->size);
+        zmemory_free(pool, sizeof(sharded_pool));
+        return 0;
+    }
+    pool->shards->references = 1;
+    pool->shards->alive = true;
+    pool->shards->size = shards_size;
+    for (u32 i = 0; i < shard_count; ++i) {
+        pool->shards->shard[i].chunks = pool->block + (u64)i * pool->shard_size;
+    }
+
+    LOGT("sharded_pool_create");
+    return pool;
+}
+
+void sharded_pool_destroy(sharded_pool* pool) {
+    if (pool == 0) {
+        LOGE("sharded_pool_destroy : invalid params");
+        return;
+    }
+    for (u32 i = 0; i < SHARDED_POOL_THREAD_SLOTS; ++i) {
+        if (thread_slots[i].shards == pool->shards) {
+            sharded_pool_slot_release(&thread_slots[i]);
+        }
+    }
+    // slots of other threads notice on their next lookup or at thread exit and drop their reference then
+    zatomic_store(&pool->shards->alive, false);
+    sharded_pool_shards_release(pool->shards);
+    zmemory_free_pages(pool->block, pool->size);
+    zmemory_free(pool, sizeof(sharded_pool));
+}
+
+void* sharded_pool_allocate(sharded_pool* pool) {
+    if (pool == 0) {
+        LOGE("sharded_pool_allocate : invalid params");
+        return 0;
+    }
+
+    sharded_pool_shard* shard = sharded_pool_shard_get(pool);
+    if (shard == 0) {
+        LOGW("sharded_pool_allocate : every shard is owned by another thread");
+        return 0;
+    }
+
+    sharded_pool_header* head = shard->head;
+    if (head == 0) {
+        // local miss, take everything other threads handed back in one swap
+        head = zatomic_exchange(&shard->remote_head, 0);
+    }
+    if (head == 0) {
+        u64 carved = shard->carved;
+        if (carved == pool->chunk_count) {
+            LOGW("sharded_pool_allocate : no free space");
+            return 0;
+        }
+        head = (sharded_pool_header*)(shard->chunks + carved * pool->chunk_size);
+        head->next = 0;
+        // frees from other threads validate against carved
+        zatomic_store(&shard->carved, carved + 1);
+    }
+    shard->head = head->next;
+    head->next = 0;
+    zatomic_store(&head->unique, SHARDED_POOL_MAGIC);
+    return (u8*)head + SHARDED_POOL_HEADER_SIZE;
+}
+
+void sharded_pool_free(sharded_pool* pool, void* block) {
+    if (pool == 0 || block == 0) {
+        LOGE("sharded_pool_free : invalid params");
+        return;
+    }
+
+    sharded_pool_header* header = (sharded_pool_header*)((u8*)block - SHARDED_POOL_HEADER_SIZE);
+    sharded_pool_shard* shard = sharded_pool_shard_of(pool, header);
+    if (shard == 0) {
+        LOGE("sharded_pool_free : invalid memory address");
+        return;
+    }
+    // taking the magic away claims the chunk, of two frees of the same block only the first gets it
+    u64 unique = SHARDED_POOL_MAGIC;
+    bool claimed = false;
+    while (unique == SHARDED_POOL_MAGIC && !claimed) {
+        claimed = zatomic_compare_exchange(&header->unique, &unique, 0);
+    }
+    if (!claimed) {
+        LOGE("sharded_pool_free : invalid memory address or double free");
+        return;
+    }
+
+    if (zatomic_load_relaxed(&shard->owner) == sharded_pool_thread_id()) {
+        header->next = shard->head;
+        shard->head = header;
+        return;
+    }
+
+    // only the owner ever detaches the whole list, so a plain push can not suffer from ABA
+    sharded_pool_header* old_head = zatomic_load_relaxed(&shard->remote_head);
+    do {
+        header->next = old_head;
+    } while (!zatomic_compare_exchange(&shard->remote_head, &old_head, header));
+}
+
+void sharded_pool_detach(sharded_pool* pool) {
+    if (pool == 0) {
+        LOGE("sharded_pool_detach : invalid params");
+        return;
+    }
+    for (u32 i = 0; i < SHARDED_POOL_THREAD_SLOTS; ++i) {
+        if (thread_slots[i].shards == pool->shards) {
+            sharded_pool_slot_release(&thread_slots[i]);
+            return;
+        }
+    }
+}
+
+void sharded_pool_reset(sharded_pool* pool) {
+    if (pool == 0) {
+        LOGE("sharded_pool_reset : invalid params");
+        return;
+    }
+    for (u32 i = 0; i < pool->shard_count; ++i) {
+        sharded_pool_shard* shard = &pool->shards->shard[i];
+        shard->head = 0;
+        shard->carved = 0;
+        zatomic_store(&shard->remote_head, 0);
+    }
+}
+
+u64 sharded_pool_thread_id() {
+    if (thread_id == 0) {
+        thread_id = zatomic_fetch_add(&sharded_pool_next_thread_id, 1) + 1;
+    }
+    return thread_id;
+}
+
+sharded_pool_shard* sharded_pool_shard_get(sharded_pool* pool) {
+    sharded_pool_slot* unused = 0;
+    for (u32 i = 0; i < SHARDED_POOL_THREAD_SLOTS; ++i) {
+        sharded_pool_slot* slot = &thread_slots[i];
+        if (slot->shards == pool->shards) {
+            return slot->shard;
+        }
+        if (slot->shards && !zatomic_load(&slot->shards->alive)) {
+            sharded_pool_slot_release(slot);
+        }
+        if (slot->shards == 0 && unused == 0) {
+            unused = slot;
+        }
+    }
+
+    if (!thread_slots_exit_registered) {
+        thread_slots_exit_registered = zthread_register_exit_callback(sharded_pool_thread_exit, 0);
+    }
+
+    u64 id = sharded_pool_thread_id();
+    for (u32 i = 0; i < pool->shard_count; ++i) {
+        sharded_pool_shard* shard = &pool->shards->shard[i];
+        u64 expected = 0;
+        bool claimed = false;
+        while (expected == 0 && !claimed) {
+            claimed = zatomic_compare_exchange(&shard->owner, &expected, id);
+        }
+        if (claimed) {
+            if (unused == 0) {
+                // too many pools on this thread, the evicted shard is handed back so another thread can adopt it
+                unused = &thread_slots[thread_slot_victim++ % SHARDED_POOL_THREAD_SLOTS];
+                sharded_pool_slot_release(unused);
+            }
+            zatomic_fetch_add(&pool->shards->references, 1);
+            unused->shards = pool->shards;
+            unused->shard = shard;
+            return shard;
+        }
+    }
+    return 0;
+}
+
+sharded_pool_shard* sharded_pool_shard_of(sharded_pool* pool, sharded_pool_header* header) {
+    u64 offset = (u64)header - (u64)pool->block;
+    if ((u64)header < (u64)pool->block || offset >= pool->size) {
+        return 0;
+    }
+    sharded_pool_shard* shard = &pool->shards->shard[offset >> pool->shard_shift];
+    u64 chunk_offset = offset & (pool->shard_size - 1);
+    u64 index = chunk_offset / pool->chunk_size;
+    if (index * pool->chunk_size != chunk_offset || index >= zatomic_load(&shard->carved)) {
+        return 0;
+    }
+    return shard;
+}
+
+void sharded_pool_slot_release(sharded_pool_slot* slot) {
+    // publishes head and carved to whoever claims the shard next
+    zatomic_store(&slot->shard->owner, 0);
+    sharded_pool_shards_release(slot->shards);
+    slot->shards = 0;
+    slot->shard = 0;
+}
+
+void sharded_pool_shards_release(sharded_pool_shards* shards) {
+    if (zatomic_fetch_sub(&shards->references, 1) == 1) {
+        zmemory_free_pages(shards, shards->size);
+    }
+}
+
+// registered with zthread_register_exit_callback, a zthread that exits gives back every shard it still owns
+void sharded_pool_thread_exit(void* params) {
+    (void)params;
+    for (u32 i = 0; i < SHARDED_POOL_THREAD_SLOTS; ++i) {
+        if (thread_slots[i].shards) {
+            sharded_pool_slot_release(&thread_slots[i]);
+        }
+    }
+    thread_slots_exit_registered = false;
+}
@@ -0,0 +1,30 @@
+#ifndef SHARDED_POOL__H
+#define SHARDED_POOL__H
+
+#include "defines.h"
+
+// a pool split into shards that each belong to one thread, the owner allocates and frees without atomics,
+// other threads free with a single CAS onto the shard's remote list which the owner takes over in bulk
+typedef struct sharded_pool sharded_pool;
+
+// shard_size is rounded up to a power of two of pages so the owning shard is one shift away
+sharded_pool* sharded_pool_create(u32 shard_count, u64 shard_size, u64 chunk_size);
+
+// every thread must have stopped using the pool
+void sharded_pool_destroy(sharded_pool* pool);
+
+// the first call on a thread claims a shard for it, 0 once the shard is full or every shard is taken
+void* sharded_pool_allocate(sharded_pool* pool);
+
+// any thread may free any chunk
+void sharded_pool_free(sharded_pool* pool, void* block);
+
+// gives the calling thread's shard back, chunks it still holds keep coming home through the remote list
+// and the next thread to claim the shard adopts both lists, a zthread does this for every pool when it exits
+// and a thread touching more pools than it has slots for hands back its oldest shard
+void sharded_pool_detach(sharded_pool* pool);
+
+// every thread must have stopped using the pool, shard ownership is kept
+void sharded_pool_reset(sharded_pool* pool);
+
+#endif
@@ -0,0 +1,157 @@
+#include "sizeclass_allocator.h"
+#include "pool_allocator.h"
+#include "zmemory.h"
+#include "logger.h"
+#include "platform.h"
+
+#define SIZECLASS_SIZE_ENTRY(size) size,
+
+static const u64 sizeclass_sizes[SIZECLASS_COUNT] = {SIZECLASS_TABLE(SIZECLASS_SIZE_ENTRY)};
+
+// one contiguous reservation split into equal power of two ranges, range i only ever holds class i,
+// so the class of any block is a subtract and a shift away and chunks need no header
+typedef struct sizeclass_allocator {
+    u8* block;
+    u64 size;
+    u64 class_capacity;
+    u32 class_shift;
+    pool_allocator* classes[SIZECLASS_COUNT];
+} sizeclass_allocator;
+
+pool_allocator* sizeclass_owner(sizeclass_allocator* allocator, void* block, u32* out_class_index);
+
+sizeclass_allocator* sizeclass_allocator_create(u64 class_capacity) {
+    if (class_capacity == 0) {
+        LOGE("sizeclass_allocator_create : invalid params");
+        return 0;
+    }
+
+    u64 capacity = platform_page_size();
+    while (capacity < class_capacity || capacity < SIZECLASS_MAX_SIZE) {
+        capacity <<= 1;
+    }
+
+    sizeclass_allocator* allocator = zmemory_allocate(sizeof(sizeclass_allocator));
+    allocator->class_capacity = capacity;
+    allocator->class_shift = __builtin_ctzll(capacity);
+    allocator->size = capacity * SIZECLASS_COUNT;
+    // untouched ranges are never faulted in, the pools carve lazily
+    allocator->block = zmemory_allocate_pages(allocator->size);
+    if (allocator->block == 0) {
+        LOGE("sizeclass_allocator_create : failed to allocate memory");
+        zmemory_free(allocator, sizeof(sizeclass_allocator));
+        return 0;
+    }
+
+    for (u32 i = 0; i < SIZECLASS_COUNT; ++i) {
+        allocator->classes[i] = pool_allocator_create_in_place(allocator->block + (u64)i * capacity, capacity,
+                                                               sizeclass_sizes[i], POOL_ALLOCATOR_FLAG_NO_HEADER);
+        if (allocator->classes[i] == 0) {
+            LOGE("sizeclass_allocator_create : failed to create pool for class %llu", sizeclass_sizes[i]);
+            sizeclass_allocator_destroy(allocator);
+            return 0;
+        }
+    }
+
+    LOGT("sizeclass_allocator_create");
+    return allocator;
+}
+
+void sizeclass_allocator_destroy(sizeclass_allocator* allocator) {
+    if (allocator == 0) {
+        LOGE("sizeclass_allocator_destroy : invalid params");
+        return;
+    }
+    for (u32 i = 0; i < SIZECLASS_COUNT; ++i) {
+        if (allocator->classes[i]) {
+            pool_allocator_destroy(allocator->classes[i]);
+        }
+    }
+    zmemory_free_pages(allocator->block, allocator->size);
+    zmemory_free(allocator, sizeof(sizeclass_allocator));
+}
+
+void* sizeclass_allocator_allocate(sizeclass_allocator* allocator, u64 size) {
+    if (allocator == 0 || size == 0) {
+        LOGE("sizeclass_allocator_allocate : invalid params");
+        return 0;
+    }
+    u32 class_index = sizeclass_allocator_class_index(size);
+    if (class_index == SIZECLASS_COUNT) {
+        LOGE("sizeclass_allocator_allocate : size %llu is above the largest class", size);
+        return 0;
+    }
+    return pool_allocator_allocate(allocator->classes[class_index]);
+}
+
+void sizeclass_allocator_free(sizeclass_allocator* allocator, void* block) {
+    if (allocator == 0 || block == 0) {
+        LOGE("sizeclass_allocator_free : invalid params");
+        return;
+    }
+    u32 class_index;
+    pool_allocator* owner = sizeclass_owner(allocator, block, &class_index);
+    if (owner == 0) {
+        LOGE("sizeclass_allocator_free : invalid memory address");
+        return;
+    }
+    pool_allocator_free(owner, block);
+}
+
+void sizeclass_allocator_reset(sizeclass_allocator* allocator) {
+    if (allocator == 0) {
+        LOGE("sizeclass_allocator_reset : invalid params");
+        return;
+    }
+    for (u32 i = 0; i < SIZECLASS_COUNT; ++i) {
+        pool_allocator_reset(allocator->classes[i]);
+    }
+}
+
+u64 sizeclass_allocator_usable_size(sizeclass_allocator* allocator, void* block) {
+    if (allocator == 0 || block == 0) {
+        LOGE("sizeclass_allocator_usable_size : invalid params");
+        return 0;
+    }
+    u32 class_index;
+    if (sizeclass_owner(allocator, block, &class_index) == 0) {
+        LOGE("sizeclass_allocator_usable_size : invalid memory address");
+        return 0;
+    }
+    return sizeclass_sizes[class_index];
+}
+
+u32 sizeclass_allocator_class_index(u64 size) {
+    if (size <= 8) {
+        return 0;
+    }
+    // 16 byte spacing up to 128, which also lands 9..16 on the 16 byte class
+    if (size <= 128) {
+        return (u32)((size + 15) >> 4);
+    }
+    if (size > SIZECLASS_MAX_SIZE) {
+        return SIZECLASS_COUNT;
+    }
+    // 2^k < size <= 2^(k + 1) is split into four classes 2^(k - 2) apart
+    u32 k = 63 - __builtin_clzll(size - 1);
+    u32 spacing_shift = k - 2;
+    u64 step = ((size - (1ull << k)) + (1ull << spacing_shift) - 1) >> spacing_shift;
+    return 8 + (k - 7) * 4 + (u32)step;
+}
+
+u64 sizeclass_allocator_class_size(u32 class_index) {
+    if (class_index >= SIZECLASS_COUNT) {
+        LOGE("sizeclass_allocator_class_size : invalid params");
+        return 0;
+    }
+    return sizeclass_sizes[class_index];
+}
+
+pool_allocator* sizeclass_owner(sizeclass_allocator* allocator, void* block, u32* out_class_index) {
+    u64 offset = (u64)block - (u64)allocator->block;
+    if ((u64)block < (u64)allocator->block || offset >= allocator->size) {
+        return 0;
+    }
+    *out_class_index = (u32)(offset >> allocator->class_shift);
+    return allocator->classes[*out_class_index];
+}
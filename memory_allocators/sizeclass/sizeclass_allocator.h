@@ -0,0 +1,40 @@
+#ifndef SIZECLASS_ALLOCATOR__H
+#define SIZECLASS_ALLOCATOR__H
+
+#include "defines.h"
+
+// jemalloc like spacing : 8, 16, then four classes per doubling up to SIZECLASS_MAX_SIZE
+#define SIZECLASS_TABLE(X)                          \
+    X(8) X(16) X(32) X(48) X(64) X(80) X(96) X(112) \
+    X(128) X(160) X(192) X(224) X(256)              \
+    X(320) X(384) X(448) X(512)                     \
+    X(640) X(768) X(896) X(1024)                    \
+    X(1280) X(1536) X(1792) X(2048)                 \
+    X(2560) X(3072) X(3584) X(4096)
+
+#define SIZECLASS_COUNT_ENTRY(size) +1
+#define SIZECLASS_COUNT (0 SIZECLASS_TABLE(SIZECLASS_COUNT_ENTRY))
+#define SIZECLASS_MAX_SIZE 4096
+
+typedef struct sizeclass_allocator sizeclass_allocator;
+
+// class_capacity is the address range reserved for every class, rounded up to a power of two of pages
+sizeclass_allocator* sizeclass_allocator_create(u64 class_capacity);
+
+void sizeclass_allocator_destroy(sizeclass_allocator* allocator);
+
+void* sizeclass_allocator_allocate(sizeclass_allocator* allocator, u64 size);
+
+void sizeclass_allocator_free(sizeclass_allocator* allocator, void* block);
+
+void sizeclass_allocator_reset(sizeclass_allocator* allocator);
+
+// size of the class the block was served from
+u64 sizeclass_allocator_usable_size(sizeclass_allocator* allocator, void* block);
+
+// index into SIZECLASS_TABLE for a request of size bytes, SIZECLASS_COUNT when it is too large
+u32 sizeclass_allocator_class_index(u64 size);
+
+u64 sizeclass_allocator_class_size(u32 class_index);
+
+#endif
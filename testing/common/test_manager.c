@@ -63,10 +63,15 @@ void test_manager_run() {
             passed += 1;
             LOGI("test passed : %s ,time_s = %lf ", test_manager[i].msg, clk.elapsed);
 
-        } else {
+        } else if (result == TEST_SKIPPED) {
 
             skipped += 1;
             LOGW("test skipped : %s ,time_s = %lf", test_manager[i].msg, clk.elapsed);
+
+        } else {
+
+            failed += 1;
+            LOGE("test failed : %s returned %u , time_s = %lf ", test_manager[i].msg, result, clk.elapsed);
         }
         // zmemory_log();
     }
@@ -3,6 +3,9 @@
 
 #include "defines.h"
 
+// tests return true, false or TEST_SKIPPED when the machine cannot run them
+#define TEST_SKIPPED 2
+
 typedef u32 (*PFN_test)();
 
 void test_manager_init();
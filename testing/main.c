@@ -6,6 +6,12 @@
 #include "testing_pool_allocator.h"
 #include "testing_freelist_allocator.h"
 #include "testing_buddy_allocator.h"
+#include "testing_sizeclass_allocator.h"
+#include "testing_object_cache.h"
+#include "testing_compact_pool.h"
+#include "testing_sharded_pool.h"
+#include "testing_buffer_pool.h"
+#include "testing_freelist_arenas.h"
 
 i32 main() {
     zmemory_init();
@@ -19,6 +25,12 @@ i32 main() {
     testing_pool_allocator();
     testing_freelist_allocator();
     testing_buddy_allocator();
+    testing_sizeclass_allocator();
+    testing_object_cache();
+    testing_compact_pool();
+    testing_sharded_pool();
+    testing_buffer_pool();
+    testing_freelist_arenas();
 
     // run tests
     test_manager_run();
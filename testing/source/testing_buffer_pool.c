@@ -0,0 +1,183 @@
+#include "testing_buffer_pool.h"
+#include "zthread.h"
+#include "expect.h"
+#include "test_manager.h"
+#include "zmemory.h"
+#include "logger.h"
+#include "buffer_pool.h"
+
+u32 test_buffer_pool_create_destroy() {
+    buffer_pool* pool = buffer_pool_create(16, 1500);
+    expect_should_not_be(0, (u64)pool);
+    // rounded up so every buffer keeps the pool's 8 byte alignment
+    expect_should_be(1504ull, buffer_pool_buffer_size(pool));
+    buffer_pool_destroy(pool);
+
+    expect_should_be(0, (u64)buffer_pool_create(0, 64));
+    expect_should_be(0, (u64)buffer_pool_create(16, 0));
+    return true;
+}
+
+u32 test_buffer_pool_ref_unref() {
+    buffer_pool* pool = buffer_pool_create(4, 256);
+    buffer_slice buffers[4];
+    for (u64 i = 0; i < 4; i++) {
+        buffers[i] = buffer_pool_acquire(pool);
+        expect_should_not_be(0, (u64)buffers[i].data);
+        expect_should_be(256ull, buffers[i].size);
+        expect_should_be(1, buffer_pool_ref_count(pool, buffers[i]));
+    }
+    expect_should_be(0, (u64)buffer_pool_acquire(pool).data);
+
+    // the buffer stays out of the pool until the last reference is gone
+    buffer_slice shared = buffer_pool_ref(pool, buffers[2]);
+    expect_should_be((u64)buffers[2].data, (u64)shared.data);
+    expect_should_be(2, buffer_pool_ref_count(pool, buffers[2]));
+    buffer_pool_unref(pool, buffers[2]);
+    expect_should_be(1, buffer_pool_ref_count(pool, shared));
+    expect_should_be(0, (u64)buffer_pool_acquire(pool).data);
+    buffer_pool_unref(pool, shared);
+    expect_should_be(0, buffer_pool_ref_count(pool, shared));
+
+    // a dead buffer can not be revived or released twice
+    expect_should_be(0, (u64)buffer_pool_ref(pool, shared).data);
+    buffer_pool_unref(pool, shared);
+
+    buffer_slice reused = buffer_pool_acquire(pool);
+    expect_should_be((u64)buffers[2].data, (u64)reused.data);
+    expect_should_be(1, buffer_pool_ref_count(pool, reused));
+
+    // foreign memory is rejected
+    u64 outside[32];
+    buffer_slice foreign = {(u8*)outside, sizeof(outside)};
+    expect_should_be(0, (u64)buffer_pool_ref(pool, foreign).data);
+    buffer_pool_unref(pool, foreign);
+
+    for (u64 i = 0; i < 4; i++) {
+        buffer_pool_unref(pool, buffers[i]);
+    }
+    buffer_pool_destroy(pool);
+    return true;
+}
+
+u32 test_buffer_pool_slice() {
+    buffer_pool* pool = buffer_pool_create(2, 1024);
+    buffer_slice packet = buffer_pool_acquire(pool);
+    for (u64 i = 0; i < packet.size; i++) {
+        packet.data[i] = (u8)i;
+    }
+
+    // header and payload views over the same bytes, no copy
+    buffer_slice header = buffer_pool_slice(pool, packet, 0, 64);
+    buffer_slice payload = buffer_pool_slice(pool, packet, 64, 960);
+    expect_should_be((u64)packet.data, (u64)header.data);
+    expect_should_be((u64)(packet.data + 64), (u64)payload.data);
+    expect_should_be(960ull, payload.size);
+    expect_should_be(64, payload.data[0]);
+    expect_should_be(3, buffer_pool_ref_count(pool, packet));
+
+    // slices of slices count against the same buffer
+    buffer_slice field = buffer_pool_slice(pool, payload, 16, 8);
+    expect_should_be((u64)(packet.data + 80), (u64)field.data);
+    expect_should_be(4, buffer_pool_ref_count(pool, header));
+
+    expect_should_be(0, (u64)buffer_pool_slice(pool, payload, 900, 61).data);
+    expect_should_be(0, (u64)buffer_pool_slice(pool, payload, 961, 1).data);
+    expect_should_be(0, (u64)buffer_pool_slice(pool, payload, 0, 0).data);
+    // a view can not claim bytes past its buffer
+    buffer_slice overrun = {payload.data, payload.size + 1};
+    expect_should_be(0, (u64)buffer_pool_ref(pool, overrun).data);
+
+    buffer_pool_unref(pool, packet);
+    buffer_pool_unref(pool, header);
+    buffer_pool_unref(pool, field);
+    expect_should_be(1, buffer_pool_ref_count(pool, payload));
+    buffer_pool_unref(pool, payload);
+
+    // both buffers are back
+    buffer_slice first = buffer_pool_acquire(pool);
+    buffer_slice second = buffer_pool_acquire(pool);
+    expect_should_not_be(0, (u64)first.data);
+    expect_should_not_be(0, (u64)second.data);
+    buffer_pool_unref(pool, first);
+    buffer_pool_unref(pool, second);
+
+    buffer_pool_destroy(pool);
+    return true;
+}
+
+#define BUFFER_CONSUMERS 4
+#define BUFFER_ROUNDS 2000
+
+typedef struct buffer_consumer_data {
+    buffer_pool* pool;
+    buffer_slice* slices; // one view per round, the reference is already taken for us
+    u64 sum;
+} buffer_consumer_data;
+
+#ifdef WINDOWS
+u32 thread_buffer_consume(void* arg) {
+#else
+void* thread_buffer_consume(void* arg) {
+#endif
+    buffer_consumer_data* data = (buffer_consumer_data*)arg;
+    for (u64 round = 0; round < BUFFER_ROUNDS; round++) {
+        buffer_slice slice = data->slices[round];
+        for (u64 i = 0; i < slice.size; i++) {
+            data->sum += slice.data[i];
+        }
+        buffer_pool_unref(data->pool, slice);
+    }
+    return 0;
+}
+
+u32 test_buffer_pool_multithreaded() {
+    // every payload fans out to all consumers, whichever finishes last returns the buffer
+    buffer_pool* pool = buffer_pool_create(BUFFER_ROUNDS, 64);
+    buffer_consumer_data data[BUFFER_CONSUMERS];
+    for (u64 c = 0; c < BUFFER_CONSUMERS; c++) {
+        data[c].pool = pool;
+        data[c].slices = zmemory_allocate(sizeof(buffer_slice) * BUFFER_ROUNDS);
+        data[c].sum = 0;
+    }
+    for (u64 round = 0; round < BUFFER_ROUNDS; round++) {
+        buffer_slice payload = buffer_pool_acquire(pool);
+        expect_should_not_be(0, (u64)payload.data);
+        zmemory_set(payload.data, 1, payload.size);
+        for (u64 c = 0; c < BUFFER_CONSUMERS; c++) {
+            data[c].slices[round] = buffer_pool_slice(pool, payload, c * 16, 16);
+        }
+        buffer_pool_unref(pool, payload);
+    }
+
+    zthread threads[BUFFER_CONSUMERS];
+    for (u64 c = 0; c < BUFFER_CONSUMERS; c++) {
+        if (!zthread_create(thread_buffer_consume, &data[c], &threads[c])) {
+            return false;
+        }
+    }
+    if (!zthread_wait_on_all(threads, BUFFER_CONSUMERS)) {
+        return false;
+    }
+    for (u64 c = 0; c < BUFFER_CONSUMERS; c++) {
+        zthread_destroy(&threads[c]);
+        expect_should_be(16ull * BUFFER_ROUNDS, data[c].sum);
+        zmemory_free(data[c].slices, sizeof(buffer_slice) * BUFFER_ROUNDS);
+    }
+
+    // every buffer went back exactly once
+    for (u64 round = 0; round < BUFFER_ROUNDS; round++) {
+        expect_should_not_be(0, (u64)buffer_pool_acquire(pool).data);
+    }
+    expect_should_be(0, (u64)buffer_pool_acquire(pool).data);
+
+    buffer_pool_destroy(pool);
+    return true;
+}
+
+void testing_buffer_pool() {
+    test_manager_register_test(test_buffer_pool_create_destroy, "test_buffer_pool_create_destroy");
+    test_manager_register_test(test_buffer_pool_ref_unref, "test_buffer_pool_ref_unref");
+    test_manager_register_test(test_buffer_pool_slice, "test_buffer_pool_slice");
+    test_manager_register_test(test_buffer_pool_multithreaded, "test_buffer_pool_multithreaded");
+}
@@ -0,0 +1,6 @@
+#ifndef TESTING_BUFFER_POOL__H
+#define TESTING_BUFFER_POOL__H
+
+void testing_buffer_pool();
+
+#endif
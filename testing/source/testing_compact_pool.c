@@ -0,0 +1,180 @@
+#include "testing_compact_pool.h"
+#include "expect.h"
+#include "test_manager.h"
+#include "zmemory.h"
+#include "clock.h"
+#include "logger.h"
+#include "compact_pool.h"
+#include "pool_allocator.h"
+
+u32 test_compact_pool_create_destroy() {
+    compact_pool* pool = compact_pool_create(1024, 4);
+    expect_should_not_be(0, (u64)pool);
+    expect_should_be(4ull, compact_pool_chunk_size(pool));
+    compact_pool_destroy(pool);
+
+    // chunk size below a u32 link or not a multiple of 4
+    expect_should_be(0, (u64)compact_pool_create(1024, 2));
+    expect_should_be(0, (u64)compact_pool_create(1024, 6));
+    expect_should_be(0, (u64)compact_pool_create(0, 8));
+    expect_should_be(0, (u64)compact_pool_create(COMPACT_POOL_MAX_CHUNKS + 1, 8));
+    return true;
+}
+
+u32 test_compact_pool_handles() {
+    // 4 byte chunks, every one of them usable
+    compact_pool* pool = compact_pool_create(100, 4);
+
+    u32 handles[100];
+    for (u32 i = 0; i < 100; i++) {
+        handles[i] = compact_pool_allocate_handle(pool);
+        expect_should_not_be(COMPACT_POOL_INVALID_HANDLE, handles[i]);
+        *(u32*)compact_pool_resolve(pool, handles[i]) = i;
+    }
+    expect_should_be(COMPACT_POOL_INVALID_HANDLE, compact_pool_allocate_handle(pool));
+
+    for (u32 i = 0; i < 100; i++) {
+        void* block = compact_pool_resolve(pool, handles[i]);
+        expect_should_be(i, *(u32*)block);
+        expect_should_be(handles[i], compact_pool_handle_of(pool, block));
+    }
+
+    // freed handles come back last in first out
+    compact_pool_free_handle(pool, handles[10]);
+    compact_pool_free_handle(pool, handles[20]);
+    expect_should_be(handles[20], compact_pool_allocate_handle(pool));
+    expect_should_be(handles[10], compact_pool_allocate_handle(pool));
+
+    for (u32 i = 0; i < 100; i++) {
+        compact_pool_free_handle(pool, handles[i]);
+    }
+    for (u32 i = 0; i < 100; i++) {
+        expect_should_not_be(COMPACT_POOL_INVALID_HANDLE, compact_pool_allocate_handle(pool));
+    }
+
+    compact_pool_destroy(pool);
+    return true;
+}
+
+u32 test_compact_pool_pointers() {
+    // 12 bytes, not a power of two
+    compact_pool* pool = compact_pool_create(64, 12);
+
+    u8* a = compact_pool_allocate(pool);
+    u8* b = compact_pool_allocate(pool);
+    expect_should_be(12ull, (u64)(b - a));
+    zmemory_set(a, 0xAB, 12);
+    zmemory_set(b, 0xCD, 12);
+    expect_should_be(0xAB, a[11]);
+
+    compact_pool_free(pool, a);
+    expect_should_be((u64)a, (u64)compact_pool_allocate(pool));
+
+    compact_pool_free(pool, a);
+    compact_pool_free(pool, b);
+    compact_pool_destroy(pool);
+    return true;
+}
+
+u32 test_compact_pool_invalid() {
+    compact_pool* pool = compact_pool_create(64, 8);
+
+    u32 handle = compact_pool_allocate_handle(pool);
+    u8* block = compact_pool_resolve(pool, handle);
+
+    // double free, never allocated handle, off stride and foreign pointers
+    compact_pool_free_handle(pool, handle);
+    compact_pool_free_handle(pool, handle);
+    compact_pool_free_handle(pool, 40);
+    compact_pool_free(pool, block + 4);
+    u64 outside;
+    compact_pool_free(pool, &outside);
+    expect_should_be(COMPACT_POOL_INVALID_HANDLE, compact_pool_handle_of(pool, &outside));
+    expect_should_be(0, (u64)compact_pool_resolve(pool, 65));
+
+    // only one copy of the chunk is on the freelist
+    expect_should_be(handle, compact_pool_allocate_handle(pool));
+    expect_should_not_be(handle, compact_pool_allocate_handle(pool));
+
+    compact_pool_reset(pool);
+    expect_should_be(1u, compact_pool_allocate_handle(pool));
+    compact_pool_free_handle(pool, 2);
+
+    compact_pool_destroy(pool);
+    return true;
+}
+
+// singly linked list of tiny nodes, the case compact pools are for
+typedef struct compact_node {
+    u32 next; // handle
+    u32 value;
+} compact_node;
+
+typedef struct pointer_node {
+    struct pointer_node* next;
+    u32 value;
+} pointer_node;
+
+u32 test_compact_pool_benchmark() {
+    clock bench_clock;
+    const u32 num_nodes = 100000;
+
+    compact_pool* pool = compact_pool_create(num_nodes, sizeof(compact_node));
+    clock_set(&bench_clock);
+    u32 head = COMPACT_POOL_INVALID_HANDLE;
+    for (u32 i = 0; i < num_nodes; i++) {
+        u32 handle = compact_pool_allocate_handle(pool);
+        compact_node* node = compact_pool_resolve(pool, handle);
+        node->next = head;
+        node->value = i;
+        head = handle;
+    }
+    u64 sum = 0;
+    while (head != COMPACT_POOL_INVALID_HANDLE) {
+        compact_node* node = compact_pool_resolve(pool, head);
+        sum += node->value;
+        u32 next = node->next;
+        compact_pool_free_handle(pool, head);
+        head = next;
+    }
+    clock_update(&bench_clock);
+    if (sum != (u64)num_nodes * (num_nodes - 1) / 2)
+        return false;
+    LOGT("compact_pool : %u nodes of %llu bytes (%llu KiB): %f seconds",
+         num_nodes, (u64)sizeof(compact_node), (u64)num_nodes * sizeof(compact_node) / 1024, bench_clock.elapsed);
+    compact_pool_destroy(pool);
+
+    // a pointer link plus the in chunk header rounds up to 32 bytes per node
+    pool_allocator* allocator = pool_allocator_create(32 * num_nodes, 32);
+    clock_set(&bench_clock);
+    pointer_node* list = 0;
+    for (u32 i = 0; i < num_nodes; i++) {
+        pointer_node* node = pool_allocator_allocate(allocator);
+        node->next = list;
+        node->value = i;
+        list = node;
+    }
+    sum = 0;
+    while (list) {
+        sum += list->value;
+        pointer_node* next = list->next;
+        pool_allocator_free(allocator, list);
+        list = next;
+    }
+    clock_update(&bench_clock);
+    if (sum != (u64)num_nodes * (num_nodes - 1) / 2)
+        return false;
+    LOGT("pool_allocator : %u nodes of 32 bytes (%llu KiB): %f seconds",
+         num_nodes, (u64)num_nodes * 32 / 1024, bench_clock.elapsed);
+    pool_allocator_destroy(allocator);
+
+    return true;
+}
+
+void testing_compact_pool() {
+    test_manager_register_test(test_compact_pool_create_destroy, "test_compact_pool_create_destroy");
+    test_manager_register_test(test_compact_pool_handles, "test_compact_pool_handles");
+    test_manager_register_test(test_compact_pool_pointers, "test_compact_pool_pointers");
+    test_manager_register_test(test_compact_pool_invalid, "test_compact_pool_invalid");
+    test_manager_register_test(test_compact_pool_benchmark, "test_compact_pool_benchmark");
+}
@@ -0,0 +1,6 @@
+#ifndef TESTING_COMPACT_POOL__H
+#define TESTING_COMPACT_POOL__H
+
+void testing_compact_pool();
+
+#endif
@@ -7,6 +7,7 @@
 #include "clock.h"
 #include "logger.h"
 #include "freelist_allocator.h"
+#include "platform.h"
 
 // Test helper functions
 u32 freelist_verify_allocation(void* ptr, u64 size) {
@@ -82,6 +83,20 @@ u32 test_freelist_allocator_edge_cases() {
     char dummy;
     freelist_allocator_free(allocator, &dummy);
 
+    // interior pointers whose bytes look like an allocated header are not taken for blocks
+    u8* block = freelist_allocator_allocate(allocator, 64);
+    u64 used = freelist_allocator_used_memory(allocator);
+    u64 forged = (0xF7B3ull << 48) | 32;
+    zmemory_copy(block + 5, &forged, sizeof(forged));
+    freelist_allocator_free(allocator, block + 13);
+    expect_should_be(used, freelist_allocator_used_memory(allocator));
+    forged = (0xF7B3ull << 48) | (1ull << 40);
+    zmemory_copy(block + 8, &forged, sizeof(forged));
+    freelist_allocator_free(allocator, block + 16);
+    expect_should_be(used, freelist_allocator_used_memory(allocator));
+    freelist_allocator_free(allocator, block);
+    expect_should_be(0, freelist_allocator_used_memory(allocator));
+
     freelist_allocator_destroy(allocator);
     return true;
 }
@@ -115,6 +130,568 @@ u32 test_freelist_allocator_fragmentation_coalescing() {
     return true;
 }
 
+u32 test_freelist_allocator_tlsf() {
+    freelist_allocator* allocator = freelist_allocator_create_with_policy(64 * 1024, FREELIST_ALLOCATOR_POLICY_TLSF);
+    expect_should_not_be(0, (u64)allocator);
+    expect_should_be(0, (u64)freelist_allocator_create_with_policy(1000, FREELIST_ALLOCATOR_POLICY_TLSF));
+
+    void* ptrs[64];
+    u64 sizes[64];
+    for (u64 i = 0; i < 64; i++) {
+        sizes[i] = 8 + (i * 37) % 700;
+        ptrs[i] = freelist_allocator_allocate(allocator, sizes[i]);
+        expect_should_be(true, freelist_verify_allocation(ptrs[i], sizes[i]));
+    }
+
+    // holes of every size class, small requests land in them without touching the tail
+    for (u64 i = 0; i < 64; i += 2) {
+        freelist_allocator_free(allocator, ptrs[i]);
+    }
+    for (u64 i = 0; i < 64; i += 2) {
+        ptrs[i] = freelist_allocator_allocate(allocator, sizes[i]);
+        expect_should_be(true, freelist_verify_allocation(ptrs[i], sizes[i]));
+    }
+
+    for (u64 i = 0; i < 64; i++) {
+        freelist_allocator_free(allocator, ptrs[i]);
+    }
+    expect_should_be(0, freelist_allocator_used_memory(allocator));
+
+    // every neighbour merged back into one block
+    void* whole = freelist_allocator_allocate(allocator, 64 * 1024 - freelist_allocator_header_size() - 8);
+    expect_should_not_be(0, (u64)whole);
+    freelist_allocator_free(allocator, whole);
+
+    freelist_allocator_destroy(allocator);
+    return true;
+}
+
+// deterministic so every policy replays the same workload
+u64 freelist_bench_random(u64* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+#define FRAGMENTED_BENCH_OPS 5000
+
+// leaves free_blocks holes of mixed sizes behind, then times allocate/free pairs that have to pick among them
+f64 freelist_fragmented_bench(freelist_allocator_policy policy, u64 free_blocks) {
+    clock bench_clock;
+    freelist_allocator* allocator = freelist_allocator_create_with_policy(32 * 1024 * 1024, policy);
+    void** ptrs = zmemory_allocate(sizeof(void*) * free_blocks * 2);
+    u64 state = 0x9E3779B97F4A7C15ull;
+    for (u64 i = 0; i < free_blocks * 2; i++) {
+        ptrs[i] = freelist_allocator_allocate(allocator, 32 + freelist_bench_random(&state) % 480);
+    }
+    for (u64 i = 0; i < free_blocks * 2; i += 2) {
+        freelist_allocator_free(allocator, ptrs[i]);
+    }
+
+    clock_set(&bench_clock);
+    for (u64 i = 0; i < FRAGMENTED_BENCH_OPS; i++) {
+        void* ptr = freelist_allocator_allocate(allocator, 16 + freelist_bench_random(&state) % 256);
+        freelist_allocator_free(allocator, ptr);
+    }
+    clock_update(&bench_clock);
+
+    zmemory_free(ptrs, sizeof(void*) * free_blocks * 2);
+    freelist_allocator_destroy(allocator);
+    return bench_clock.elapsed;
+}
+
+u32 test_freelist_allocator_fragmented_benchmark() {
+    u64 free_blocks[] = {100, 1000, 5000};
+    for (u64 i = 0; i < sizeof(free_blocks) / sizeof(free_blocks[0]); i++) {
+        f64 best_fit = freelist_fragmented_bench(FREELIST_ALLOCATOR_POLICY_BEST_FIT, free_blocks[i]);
+        f64 tlsf = freelist_fragmented_bench(FREELIST_ALLOCATOR_POLICY_TLSF, free_blocks[i]);
+        f64 tree = freelist_fragmented_bench(FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE, free_blocks[i]);
+        LOGT("%llu free blocks, %d allocate/free pairs : best fit %f seconds, tlsf %f seconds, best fit tree %f seconds",
+             free_blocks[i], FRAGMENTED_BENCH_OPS, best_fit, tlsf, tree);
+    }
+    return true;
+}
+
+u32 test_freelist_allocator_boundary_tags() {
+    freelist_allocator_policy policies[] = {FREELIST_ALLOCATOR_POLICY_BEST_FIT, FREELIST_ALLOCATOR_POLICY_TLSF,
+                                            FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE};
+    for (u64 p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        freelist_allocator* allocator = freelist_allocator_create_with_policy(1024, policies[p]);
+        const u64 block_size = 128 + freelist_allocator_header_size();
+        void* ptrs[4];
+        for (u64 i = 0; i < 4; i++) {
+            ptrs[i] = freelist_allocator_allocate(allocator, 128);
+            expect_should_not_be(0, (u64)ptrs[i]);
+        }
+
+        // nothing but the blocks under test is left free
+        void* fence = freelist_allocator_allocate(allocator, 1024 - block_size * 4 - freelist_allocator_header_size());
+        expect_should_not_be(0, (u64)fence);
+
+        // the middle free merges with the free blocks on both sides at once
+        freelist_allocator_free(allocator, ptrs[0]);
+        freelist_allocator_free(allocator, ptrs[2]);
+        freelist_allocator_free(allocator, ptrs[1]);
+        expect_should_be(1024 - block_size * 3, freelist_allocator_used_memory(allocator));
+
+        // more than two blocks worth only fits if all three merged
+        u64 merged_size = block_size * 2 + 64 - freelist_allocator_header_size();
+        void* merged = freelist_allocator_allocate(allocator, merged_size);
+        expect_should_be((u64)ptrs[0], (u64)merged);
+        expect_should_be(true, freelist_verify_allocation(merged, merged_size));
+
+        // and the last block merges with the blocks on both sides on its way back
+        freelist_allocator_free(allocator, merged);
+        freelist_allocator_free(allocator, fence);
+        freelist_allocator_free(allocator, ptrs[3]);
+        expect_should_be(0, freelist_allocator_used_memory(allocator));
+        void* whole = freelist_allocator_allocate(allocator, 1024 - freelist_allocator_header_size() - 8);
+        expect_should_be((u64)ptrs[0], (u64)whole);
+
+        freelist_allocator_destroy(allocator);
+    }
+    return true;
+}
+
+u32 test_freelist_allocator_best_fit_tree() {
+    freelist_allocator* allocator = freelist_allocator_create_with_policy(64 * 1024, FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE);
+    u64 hole_sizes[] = {200, 136, 600, 144, 136, 300};
+    void* holes[6];
+    for (u64 i = 0; i < 6; i++) {
+        holes[i] = freelist_allocator_allocate(allocator, hole_sizes[i]);
+        // keeps the holes from merging
+        expect_should_not_be(0, (u64)freelist_allocator_allocate(allocator, 8));
+    }
+    for (u64 i = 0; i < 6; i++) {
+        freelist_allocator_free(allocator, holes[i]);
+    }
+
+    // exact fits win, equal sizes go to the lower address
+    expect_should_be((u64)holes[1], (u64)freelist_allocator_allocate(allocator, 136));
+    expect_should_be((u64)holes[4], (u64)freelist_allocator_allocate(allocator, 130));
+    expect_should_be((u64)holes[3], (u64)freelist_allocator_allocate(allocator, 140));
+    expect_should_be((u64)holes[0], (u64)freelist_allocator_allocate(allocator, 145));
+    freelist_allocator_reset(allocator);
+
+    // random churn keeps every live block intact
+    void* ptrs[256] = {0};
+    u64 sizes[256];
+    u64 state = 0x2545F4914F6CDD1Dull;
+    for (u64 op = 0; op < 20000; op++) {
+        u64 slot = freelist_bench_random(&state) % 256;
+        if (ptrs[slot]) {
+            expect_should_be((u8)slot, *((u8*)ptrs[slot] + sizes[slot] - 1));
+            freelist_allocator_free(allocator, ptrs[slot]);
+            ptrs[slot] = 0;
+        } else {
+            sizes[slot] = 1 + freelist_bench_random(&state) % 200;
+            ptrs[slot] = freelist_allocator_allocate(allocator, sizes[slot]);
+            expect_should_not_be(0, (u64)ptrs[slot]);
+            zmemory_set(ptrs[slot], (u8)slot, sizes[slot]);
+        }
+    }
+    for (u64 slot = 0; slot < 256; slot++) {
+        if (ptrs[slot]) {
+            expect_should_be((u8)slot, *(u8*)ptrs[slot]);
+            freelist_allocator_free(allocator, ptrs[slot]);
+        }
+    }
+    expect_should_be(0, freelist_allocator_used_memory(allocator));
+    expect_should_not_be(0, (u64)freelist_allocator_allocate(allocator, 64 * 1024 - freelist_allocator_header_size() - 8));
+
+    freelist_allocator_destroy(allocator);
+    return true;
+}
+
+u32 test_freelist_allocator_reallocate() {
+    freelist_allocator_policy policies[] = {FREELIST_ALLOCATOR_POLICY_BEST_FIT, FREELIST_ALLOCATOR_POLICY_TLSF,
+                                            FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE};
+    const u64 header_size = freelist_allocator_header_size();
+    for (u64 p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        freelist_allocator* allocator = freelist_allocator_create_with_policy(4096, policies[p]);
+        u8* ptr = freelist_allocator_reallocate(allocator, 0, 512);
+        expect_should_not_be(0, (u64)ptr);
+        for (u64 i = 0; i < 512; i++) {
+            ptr[i] = (u8)i;
+        }
+        u8* fence = freelist_allocator_allocate(allocator, 64);
+
+        // shrinking stays put and hands the tail back
+        expect_should_be((u64)ptr, (u64)freelist_allocator_reallocate(allocator, ptr, 128));
+        expect_should_be(128 + header_size + 64 + header_size, freelist_allocator_used_memory(allocator));
+        u8* tail = freelist_allocator_allocate(allocator, 256);
+        expect_should_be((u64)(ptr + 128 + header_size), (u64)tail);
+        freelist_allocator_free(allocator, tail);
+
+        // the tail is free again, so growing back swallows it without moving
+        expect_should_be((u64)ptr, (u64)freelist_allocator_reallocate(allocator, ptr, 400));
+        expect_should_be(400 + header_size + 64 + header_size, freelist_allocator_used_memory(allocator));
+        for (u64 i = 0; i < 128; i++) {
+            expect_should_be((u8)i, ptr[i]);
+        }
+
+        // past the fence only a move helps, the data comes along
+        u8* moved = freelist_allocator_reallocate(allocator, ptr, 1024);
+        expect_should_not_be(0, (u64)moved);
+        expect_should_not_be((u64)ptr, (u64)moved);
+        for (u64 i = 0; i < 128; i++) {
+            expect_should_be((u8)i, moved[i]);
+        }
+        expect_should_be(1024 + header_size + 64 + header_size, freelist_allocator_used_memory(allocator));
+
+        // a failed move leaves the block alone
+        expect_should_be(0, (u64)freelist_allocator_reallocate(allocator, moved, 4000));
+        expect_should_be((u8)127, moved[127]);
+        u64 outside;
+        expect_should_be(0, (u64)freelist_allocator_reallocate(allocator, &outside, 64));
+
+        expect_should_be(0, (u64)freelist_allocator_reallocate(allocator, moved, 0));
+        freelist_allocator_free(allocator, fence);
+        expect_should_be(0, freelist_allocator_used_memory(allocator));
+        freelist_allocator_destroy(allocator);
+    }
+    return true;
+}
+
+u32 test_freelist_allocator_allocate_aligned() {
+    freelist_allocator_policy policies[] = {FREELIST_ALLOCATOR_POLICY_BEST_FIT, FREELIST_ALLOCATOR_POLICY_TLSF,
+                                            FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE};
+    for (u64 p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        freelist_allocator* allocator = freelist_allocator_create_with_policy(64 * 1024, policies[p]);
+        void* ptrs[10];
+        u64 expected_used = 0;
+        for (u64 i = 0; i < 10; i++) {
+            u64 alignment = 8ull << i;
+            u64 size = 24 + i * 40;
+            ptrs[i] = freelist_allocator_allocate_aligned(allocator, size, alignment);
+            expect_should_not_be(0, (u64)ptrs[i]);
+            u64 misalignment = (u64)ptrs[i] & (alignment - 1);
+            expect_should_be(0, misalignment);
+            expect_should_be(true, freelist_verify_allocation(ptrs[i], size));
+            // padding is not charged to the block
+            expected_used += ((size + freelist_allocator_header_size() + 7) & ~7ull);
+            expect_should_be(expected_used, freelist_allocator_used_memory(allocator));
+        }
+
+        // padding in front of a block merges back when the block goes
+        for (u64 i = 0; i < 10; i++) {
+            freelist_allocator_free(allocator, ptrs[i]);
+        }
+        expect_should_be(0, freelist_allocator_used_memory(allocator));
+        expect_should_not_be(0, (u64)freelist_allocator_allocate(allocator, 64 * 1024 - freelist_allocator_header_size() - 8));
+
+        expect_should_be(0, (u64)freelist_allocator_allocate_aligned(allocator, 64, 24));
+        expect_should_be(0, (u64)freelist_allocator_allocate_aligned(allocator, 64, 16 * 1024 * 1024));
+        freelist_allocator_destroy(allocator);
+    }
+    return true;
+}
+
+u32 test_freelist_allocator_overhead_benchmark() {
+    const u64 count = 10000;
+    u64 sizes[] = {8, 16, 24, 32, 48, 64, 128};
+    freelist_allocator* allocator = freelist_allocator_create_with_policy(4 * 1024 * 1024, FREELIST_ALLOCATOR_POLICY_TLSF);
+    expect_should_be(8, freelist_allocator_header_size());
+    for (u64 i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (u64 j = 0; j < count; j++) {
+            expect_should_not_be(0, (u64)freelist_allocator_allocate(allocator, sizes[i]));
+        }
+        u64 overhead = (freelist_allocator_used_memory(allocator) - count * sizes[i]) / count;
+        LOGT("freelist : %llu allocations of %llu bytes, %llu bytes of overhead each (%f%% of the payload)", count,
+             sizes[i], overhead, 100.0 * overhead / sizes[i]);
+        // below 24 bytes the block still has to fit the free links and footer once it is freed
+        if (sizes[i] >= 24) {
+            expect_should_be(8, overhead);
+        }
+        freelist_allocator_reset(allocator);
+    }
+    freelist_allocator_destroy(allocator);
+    return true;
+}
+
+u32 test_freelist_allocator_placement_policies() {
+    freelist_allocator_policy policies[] = {FREELIST_ALLOCATOR_POLICY_FIRST_FIT, FREELIST_ALLOCATOR_POLICY_NEXT_FIT,
+                                            FREELIST_ALLOCATOR_POLICY_BEST_FIT};
+    for (u64 p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        freelist_allocator* allocator = freelist_allocator_create_with_policy(4096, policies[p]);
+        // three fenced holes, freed so the list reads 300, 100, 200, tail
+        u8* holes[3];
+        u64 hole_sizes[] = {300, 100, 200};
+        for (u64 i = 0; i < 3; i++) {
+            holes[i] = freelist_allocator_allocate(allocator, hole_sizes[i]);
+            freelist_allocator_allocate(allocator, 8);
+        }
+        for (i32 i = 2; i >= 0; i--) {
+            freelist_allocator_free(allocator, holes[i]);
+        }
+
+        u8* first = freelist_allocator_allocate(allocator, 90);
+        u8* second = freelist_allocator_allocate(allocator, 90);
+        if (policies[p] == FREELIST_ALLOCATOR_POLICY_FIRST_FIT) {
+            // the remainder of the first hole went back to the front of the list
+            expect_should_be((u64)holes[0], (u64)first);
+            expect_should_be((u64)(holes[0] + 104), (u64)second);
+        } else if (policies[p] == FREELIST_ALLOCATOR_POLICY_NEXT_FIT) {
+            // the search picks up after the block it split
+            expect_should_be((u64)holes[0], (u64)first);
+            expect_should_be((u64)holes[1], (u64)second);
+        } else {
+            expect_should_be((u64)holes[1], (u64)first);
+            expect_should_be((u64)holes[2], (u64)second);
+        }
+
+        // no size cap hides a large block from the search
+        freelist_allocator_reset(allocator);
+        expect_should_not_be(0, (u64)freelist_allocator_allocate(allocator, 8));
+        expect_should_not_be(0, (u64)freelist_allocator_allocate(allocator, 4096 - 32 - freelist_allocator_header_size()));
+        expect_should_be(0, freelist_allocator_largest_free_block(allocator));
+        freelist_allocator_destroy(allocator);
+    }
+    return true;
+}
+
+#define POLICY_BENCH_SLOTS 2048
+#define POLICY_BENCH_OPS 100000
+
+u32 test_freelist_allocator_policy_benchmark() {
+    clock bench_clock;
+    const char* names[] = {"best fit", "tlsf", "best fit tree", "first fit", "next fit"};
+    freelist_allocator_policy policies[] = {FREELIST_ALLOCATOR_POLICY_BEST_FIT, FREELIST_ALLOCATOR_POLICY_TLSF,
+                                            FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE, FREELIST_ALLOCATOR_POLICY_FIRST_FIT,
+                                            FREELIST_ALLOCATOR_POLICY_NEXT_FIT};
+    void** ptrs = zmemory_allocate(sizeof(void*) * POLICY_BENCH_SLOTS);
+    for (u64 p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        // tight enough that placement decides whether requests still fit
+        freelist_allocator* allocator = freelist_allocator_create_with_policy(512 * 1024, policies[p]);
+        zmemory_set_zero(ptrs, sizeof(void*) * POLICY_BENCH_SLOTS);
+        u64 state = 0x853C49E6748FEA9Bull;
+        u64 failed = 0;
+
+        clock_set(&bench_clock);
+        for (u64 op = 0; op < POLICY_BENCH_OPS; op++) {
+            u64 slot = freelist_bench_random(&state) % POLICY_BENCH_SLOTS;
+            u64 roll = freelist_bench_random(&state);
+            if (ptrs[slot]) {
+                freelist_allocator_free(allocator, ptrs[slot]);
+                ptrs[slot] = 0;
+            } else {
+                // mostly small, now and then a large one
+                u64 size = (roll & 15) ? 16 + roll % 256 : 1024 + roll % 4096;
+                ptrs[slot] = freelist_allocator_allocate(allocator, size);
+                failed += ptrs[slot] == 0;
+            }
+        }
+        clock_update(&bench_clock);
+
+        u64 free_memory = freelist_allocator_unused_memory(allocator);
+        u64 largest = freelist_allocator_largest_free_block(allocator);
+        LOGT("freelist %s : %f Mops/s, %llu failed allocations, fragmentation %f (1 - largest free / free memory)",
+             names[p], POLICY_BENCH_OPS / bench_clock.elapsed / 1000000.0, failed,
+             free_memory ? 1.0 - (f64)largest / free_memory : 0.0);
+        freelist_allocator_destroy(allocator);
+    }
+    zmemory_free(ptrs, sizeof(void*) * POLICY_BENCH_SLOTS);
+    return true;
+}
+
+u32 test_freelist_allocator_growable() {
+    freelist_allocator_policy policies[] = {FREELIST_ALLOCATOR_POLICY_BEST_FIT, FREELIST_ALLOCATOR_POLICY_TLSF,
+                                            FREELIST_ALLOCATOR_POLICY_BEST_FIT_TREE, FREELIST_ALLOCATOR_POLICY_FIRST_FIT,
+                                            FREELIST_ALLOCATOR_POLICY_NEXT_FIT};
+    for (u64 p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        freelist_allocator* allocator = freelist_allocator_create_growable(64 * 1024, policies[p]);
+        expect_should_not_be(0, (u64)allocator);
+        // one region is mapped up front
+        u64 region_capacity = freelist_allocator_unused_memory(allocator);
+
+        // far more than one region holds
+        u8* ptrs[64];
+        for (u64 i = 0; i < 64; i++) {
+            ptrs[i] = freelist_allocator_allocate(allocator, 4000);
+            expect_should_not_be(0, (u64)ptrs[i]);
+            zmemory_set(ptrs[i], (i32)i, 4000);
+        }
+        u64 mapped = freelist_allocator_used_memory(allocator) + freelist_allocator_unused_memory(allocator);
+        bool spilled = mapped >= 4 * region_capacity;
+        expect_should_be(true, spilled);
+        for (u64 i = 0; i < 64; i++) {
+            expect_should_be((u8)i, ptrs[i][0]);
+            expect_should_be((u8)i, ptrs[i][3999]);
+        }
+
+        // a whole region for one block, which goes straight back once freed
+        expect_should_be(0, (u64)freelist_allocator_allocate(allocator, region_capacity));
+        u8* whole = freelist_allocator_allocate(allocator, region_capacity - freelist_allocator_header_size());
+        expect_should_not_be(0, (u64)whole);
+        u64 grown = freelist_allocator_used_memory(allocator) + freelist_allocator_unused_memory(allocator);
+        expect_should_be(mapped + region_capacity, grown);
+        freelist_allocator_free(allocator, whole);
+        u64 shrunk = freelist_allocator_used_memory(allocator) + freelist_allocator_unused_memory(allocator);
+        expect_should_be(mapped, shrunk);
+
+        // pointers outside every region are turned away
+        u64 local = 0;
+        freelist_allocator_free(allocator, &local);
+        freelist_allocator_free(allocator, ptrs[0] + 64 * 1024 * 1024);
+
+        // moving to another region keeps the data
+        ptrs[0] = freelist_allocator_reallocate(allocator, ptrs[0], 32 * 1024);
+        expect_should_not_be(0, (u64)ptrs[0]);
+        expect_should_be(0, ptrs[0][3999]);
+
+        // emptied regions are unmapped until only one is left
+        for (u64 i = 0; i < 64; i++) {
+            freelist_allocator_free(allocator, ptrs[i]);
+        }
+        expect_should_be(0, freelist_allocator_used_memory(allocator));
+        expect_should_be(region_capacity, freelist_allocator_unused_memory(allocator));
+
+        for (u64 i = 0; i < 64; i++) {
+            expect_should_not_be(0, (u64)freelist_allocator_allocate(allocator, 4000));
+        }
+        freelist_allocator_reset(allocator);
+        expect_should_be(region_capacity, freelist_allocator_unused_memory(allocator));
+        expect_should_be(region_capacity - freelist_allocator_header_size(), freelist_allocator_largest_free_block(allocator));
+        freelist_allocator_destroy(allocator);
+    }
+    expect_should_be(0, (u64)freelist_allocator_create_growable(0, FREELIST_ALLOCATOR_POLICY_BEST_FIT));
+    return true;
+}
+
+u32 test_freelist_allocator_huge() {
+    // growable, so requests far past one region are still served on the direct path
+    freelist_allocator* allocator = freelist_allocator_create_growable(64 * 1024, FREELIST_ALLOCATOR_POLICY_BEST_FIT);
+    freelist_allocator_set_huge_threshold(allocator, 256 * 1024);
+    u64 page_size = platform_page_size();
+
+    // served from pages of its own, the free blocks are untouched
+    u8* huge = freelist_allocator_allocate(allocator, 1024 * 1024 + 1);
+    expect_should_not_be(0, (u64)huge);
+    u64 offset = (u64)huge & (page_size - 1);
+    expect_should_be(0, offset);
+    expect_should_be(0, freelist_allocator_used_memory(allocator));
+    u64 mapped = (1024 * 1024 + page_size) & ~(page_size - 1);
+    expect_should_be(mapped, freelist_allocator_huge_memory(allocator));
+    for (u64 i = 0; i < 1024 * 1024; i += page_size) {
+        huge[i] = (u8)(i / page_size);
+    }
+
+    // grows and shrinks by remapping, the contents come along
+    huge = freelist_allocator_reallocate(allocator, huge, 8 * 1024 * 1024);
+    expect_should_not_be(0, (u64)huge);
+    expect_should_be(8 * 1024 * 1024ull, freelist_allocator_huge_memory(allocator));
+    huge[8 * 1024 * 1024 - 1] = 0xFF;
+    huge = freelist_allocator_reallocate(allocator, huge, 300 * 1024);
+    for (u64 i = 0; i < 300 * 1024; i += page_size) {
+        expect_should_be((u8)(i / page_size), huge[i]);
+    }
+    mapped = (300 * 1024 + page_size - 1) & ~(page_size - 1);
+    expect_should_be(mapped, freelist_allocator_huge_memory(allocator));
+
+    // below the threshold the block moves onto the free blocks, and back out above it
+    huge[999] = 0x77;
+    u8* small = freelist_allocator_reallocate(allocator, huge, 1000);
+    expect_should_not_be(0, (u64)small);
+    expect_should_be(0, freelist_allocator_huge_memory(allocator));
+    expect_should_not_be(0, freelist_allocator_used_memory(allocator));
+    expect_should_be(0x77, small[999]);
+    huge = freelist_allocator_reallocate(allocator, small, 512 * 1024);
+    expect_should_be(0, freelist_allocator_used_memory(allocator));
+    expect_should_be(0x77, huge[999]);
+    freelist_allocator_free(allocator, huge);
+    expect_should_be(0, freelist_allocator_huge_memory(allocator));
+
+    // enough live blocks to grow the side table, freed out of order
+    u8* ptrs[100];
+    for (u64 i = 0; i < 100; i++) {
+        ptrs[i] = freelist_allocator_allocate_aligned(allocator, 256 * 1024 + i * page_size, 64);
+        expect_should_not_be(0, (u64)ptrs[i]);
+    }
+    for (u64 i = 0; i < 100; i++) {
+        freelist_allocator_free(allocator, ptrs[(i * 37) % 100]);
+    }
+    expect_should_be(0, freelist_allocator_huge_memory(allocator));
+
+    // reset unmaps what is left
+    expect_should_not_be(0, (u64)freelist_allocator_allocate(allocator, 2 * 1024 * 1024));
+    freelist_allocator_reset(allocator);
+    expect_should_be(0, freelist_allocator_huge_memory(allocator));
+
+    // without the direct path the request is too large again
+    freelist_allocator_set_huge_threshold(allocator, 0);
+    expect_should_be(0, (u64)freelist_allocator_allocate(allocator, 1024 * 1024));
+    freelist_allocator_destroy(allocator);
+    return true;
+}
+
+u32 test_freelist_allocator_huge_fixed() {
+    // off by default, a fixed allocator rejects what does not fit its block
+    freelist_allocator* allocator = freelist_allocator_create(1024);
+    expect_should_be(0, (u64)freelist_allocator_allocate(allocator, 4 * 1024 * 1024));
+    expect_should_be(0, (u64)freelist_allocator_allocate_aligned(allocator, 4 * 1024 * 1024, 64));
+    expect_should_be(0, freelist_allocator_huge_memory(allocator));
+
+    // and keeps rejecting it once the direct path is on
+    freelist_allocator_set_huge_threshold(allocator, 512);
+    expect_should_be(0, (u64)freelist_allocator_allocate(allocator, 4 * 1024 * 1024));
+    expect_should_be(0, freelist_allocator_huge_memory(allocator));
+    freelist_allocator_destroy(allocator);
+
+    // below the capacity large requests skip the free blocks once a threshold is set
+    allocator = freelist_allocator_create(16 * 1024 * 1024);
+    void* block = freelist_allocator_allocate(allocator, 1024 * 1024);
+    expect_should_not_be(0, freelist_allocator_used_memory(allocator));
+    expect_should_be(0, freelist_allocator_huge_memory(allocator));
+    freelist_allocator_free(allocator, block);
+    freelist_allocator_set_huge_threshold(allocator, 256 * 1024);
+    block = freelist_allocator_allocate(allocator, 1024 * 1024);
+    expect_should_be(0, freelist_allocator_used_memory(allocator));
+    expect_should_be(1024 * 1024ull, freelist_allocator_huge_memory(allocator));
+    freelist_allocator_free(allocator, block);
+    expect_should_be(0, freelist_allocator_huge_memory(allocator));
+    freelist_allocator_destroy(allocator);
+    return true;
+}
+
+#define HUGE_BENCH_STEP (1024 * 1024)
+#define HUGE_BENCH_STEPS 12
+
+u32 test_freelist_allocator_huge_realloc_benchmark() {
+    clock bench_clock;
+    // the threshold is 0 for the copying run, the block grows inside the free blocks
+    u64 thresholds[] = {0, HUGE_BENCH_STEP};
+    const char* names[] = {"free blocks", "mremap"};
+    for (u64 t = 0; t < 2; t++) {
+        freelist_allocator* allocator = freelist_allocator_create_with_policy(64 * 1024 * 1024, FREELIST_ALLOCATOR_POLICY_TLSF);
+        freelist_allocator_set_huge_threshold(allocator, thresholds[t]);
+        // two blocks grown in turns, each one sits right behind the other so neither grows in place
+        u8* blocks[2];
+        for (u64 b = 0; b < 2; b++) {
+            blocks[b] = freelist_allocator_allocate(allocator, HUGE_BENCH_STEP);
+            zmemory_set(blocks[b], 0x5A, HUGE_BENCH_STEP);
+        }
+
+        clock_set(&bench_clock);
+        for (u64 i = 2; i <= HUGE_BENCH_STEPS; i++) {
+            for (u64 b = 0; b < 2; b++) {
+                blocks[b] = freelist_allocator_reallocate(allocator, blocks[b], i * HUGE_BENCH_STEP);
+                if (blocks[b] == 0) {
+                    return false;
+                }
+            }
+        }
+        clock_update(&bench_clock);
+
+        LOGT("freelist %s : grew two blocks from 1 to %d MiB in 1 MiB steps: %f seconds", names[t], HUGE_BENCH_STEPS,
+             bench_clock.elapsed);
+        expect_should_be(0x5A, blocks[0][HUGE_BENCH_STEP - 1]);
+        expect_should_be(0x5A, blocks[1][HUGE_BENCH_STEP - 1]);
+        freelist_allocator_destroy(allocator);
+    }
+    return true;
+}
+
 // Multithreading test structures
 #define NUM_THREADS 4
 #define ALLOCS_PER_THREAD 100
@@ -248,4 +825,17 @@ void testing_freelist_allocator() {
     test_manager_register_test(test_freelist_allocator_edge_cases, "test_freelist_allocator_edge_cases");
     test_manager_register_test(test_freelist_allocator_reset, "test_freelist_allocator_reset");
     test_manager_register_test(test_freelist_allocator_benchmark, "test_freelist_allocator_benchmark");
+    test_manager_register_test(test_freelist_allocator_tlsf, "test_freelist_allocator_tlsf");
+    test_manager_register_test(test_freelist_allocator_fragmented_benchmark, "test_freelist_allocator_fragmented_benchmark");
+    test_manager_register_test(test_freelist_allocator_boundary_tags, "test_freelist_allocator_boundary_tags");
+    test_manager_register_test(test_freelist_allocator_best_fit_tree, "test_freelist_allocator_best_fit_tree");
+    test_manager_register_test(test_freelist_allocator_reallocate, "test_freelist_allocator_reallocate");
+    test_manager_register_test(test_freelist_allocator_allocate_aligned, "test_freelist_allocator_allocate_aligned");
+    test_manager_register_test(test_freelist_allocator_overhead_benchmark, "test_freelist_allocator_overhead_benchmark");
+    test_manager_register_test(test_freelist_allocator_placement_policies, "test_freelist_allocator_placement_policies");
+    test_manager_register_test(test_freelist_allocator_policy_benchmark, "test_freelist_allocator_policy_benchmark");
+    test_manager_register_test(test_freelist_allocator_growable, "test_freelist_allocator_growable");
+    test_manager_register_test(test_freelist_allocator_huge, "test_freelist_allocator_huge");
+    test_manager_register_test(test_freelist_allocator_huge_fixed, "test_freelist_allocator_huge_fixed");
+    test_manager_register_test(test_freelist_allocator_huge_realloc_benchmark, "test_freelist_allocator_huge_realloc_benchmark");
 }
@@ -0,0 +1,186 @@
+#include "testing_freelist_arenas.h"
+#include "zthread.h"
+#include "expect.h"
+#include "test_manager.h"
+#include "zmemory.h"
+#include "clock.h"
+#include "logger.h"
+#include "freelist_arenas.h"
+
+#define ARENAS_THREADS 4
+#define ARENAS_BLOCKS_PER_THREAD 100
+
+u32 test_freelist_arenas_create_destroy() {
+    freelist_arenas* arenas = freelist_arenas_create(4, 64 * 1024, FREELIST_ALLOCATOR_POLICY_TLSF);
+    expect_should_not_be(0, (u64)arenas);
+    expect_should_be(0, freelist_arenas_used_memory(arenas));
+    freelist_arenas_destroy(arenas);
+
+    expect_should_be(0, (u64)freelist_arenas_create(0, 64 * 1024, FREELIST_ALLOCATOR_POLICY_TLSF));
+    expect_should_be(0, (u64)freelist_arenas_create(4, 0, FREELIST_ALLOCATOR_POLICY_TLSF));
+    return true;
+}
+
+u32 test_freelist_arenas_alloc_free() {
+    freelist_arenas* arenas = freelist_arenas_create(4, 64 * 1024, FREELIST_ALLOCATOR_POLICY_TLSF);
+    u8* block = freelist_arenas_allocate(arenas, 100);
+    expect_should_not_be(0, (u64)block);
+    zmemory_set(block, 0xAB, 100);
+    expect_should_be(freelist_arenas_thread_arena(arenas), freelist_arenas_owner(arenas, block));
+    freelist_arenas_free(arenas, block);
+    expect_should_be(0, freelist_arenas_used_memory(arenas));
+
+    // a block carries only the freelist header, no arena word in front of it
+    block = freelist_arenas_allocate(arenas, 64);
+    expect_should_be(64 + 8, freelist_arenas_used_memory(arenas));
+    freelist_arenas_free(arenas, block);
+
+    // memory no arena owns is turned away without being read
+    u64 foreign[2] = {0, 0};
+    expect_should_be(FREELIST_ARENAS_NO_OWNER, freelist_arenas_owner(arenas, &foreign[1]));
+    expect_should_be(FREELIST_ARENAS_NO_OWNER, freelist_arenas_owner(arenas, 0));
+    expect_should_be(FREELIST_ARENAS_NO_OWNER, freelist_arenas_owner(0, block));
+    freelist_arenas_free(arenas, &foreign[1]);
+    expect_should_be(0, freelist_arenas_used_memory(arenas));
+
+    freelist_arenas_destroy(arenas);
+    return true;
+}
+
+typedef struct arenas_thread_data {
+    freelist_arenas* arenas;
+    void* ptrs[ARENAS_BLOCKS_PER_THREAD];
+    u32 arena;
+} arenas_thread_data;
+
+#ifdef WINDOWS
+u32 thread_freelist_arenas_allocate(void* arg) {
+#else
+void* thread_freelist_arenas_allocate(void* arg) {
+#endif
+    arenas_thread_data* data = (arenas_thread_data*)arg;
+    data->arena = freelist_arenas_thread_arena(data->arenas);
+    for (u64 i = 0; i < ARENAS_BLOCKS_PER_THREAD; i++) {
+        data->ptrs[i] = freelist_arenas_allocate(data->arenas, 16 + i * 8);
+    }
+    return 0;
+}
+
+u32 test_freelist_arenas_remote_free() {
+    freelist_arenas* arenas = freelist_arenas_create(ARENAS_THREADS, 64 * 1024, FREELIST_ALLOCATOR_POLICY_BEST_FIT);
+    arenas_thread_data data[ARENAS_THREADS];
+    zthread threads[ARENAS_THREADS];
+    for (u64 i = 0; i < ARENAS_THREADS; i++) {
+        data[i].arenas = arenas;
+        if (!zthread_create(thread_freelist_arenas_allocate, &data[i], &threads[i])) {
+            return false;
+        }
+    }
+    if (!zthread_wait_on_all(threads, ARENAS_THREADS)) {
+        return false;
+    }
+
+    // threads starting together land on different arenas, and their blocks carry their arena
+    u32 seen = 0;
+    for (u64 i = 0; i < ARENAS_THREADS; i++) {
+        zthread_destroy(&threads[i]);
+        seen |= 1u << data[i].arena;
+        for (u64 j = 0; j < ARENAS_BLOCKS_PER_THREAD; j++) {
+            expect_should_not_be(0, (u64)data[i].ptrs[j]);
+            expect_should_be(data[i].arena, freelist_arenas_owner(arenas, data[i].ptrs[j]));
+        }
+    }
+    expect_should_be((1u << ARENAS_THREADS) - 1, seen);
+
+    // this thread frees everything, a block freed into the wrong arena would be refused and stay used
+    for (u64 i = 0; i < ARENAS_THREADS; i++) {
+        for (u64 j = 0; j < ARENAS_BLOCKS_PER_THREAD; j++) {
+            freelist_arenas_free(arenas, data[i].ptrs[j]);
+        }
+    }
+    expect_should_be(0, freelist_arenas_used_memory(arenas));
+
+    freelist_arenas_destroy(arenas);
+    return true;
+}
+
+#define ARENAS_BENCH_SLOTS 256
+#define ARENAS_BENCH_OPS 200000
+
+typedef struct arenas_bench_data {
+    freelist_arenas* arenas;
+    u64 seed;
+    u64 failed;
+} arenas_bench_data;
+
+#ifdef WINDOWS
+u32 thread_freelist_arenas_bench(void* arg) {
+#else
+void* thread_freelist_arenas_bench(void* arg) {
+#endif
+    arenas_bench_data* data = (arenas_bench_data*)arg;
+    void* ptrs[ARENAS_BENCH_SLOTS] = {0};
+    u64 state = data->seed;
+    for (u64 op = 0; op < ARENAS_BENCH_OPS; op++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        u64 slot = state % ARENAS_BENCH_SLOTS;
+        if (ptrs[slot]) {
+            freelist_arenas_free(data->arenas, ptrs[slot]);
+            ptrs[slot] = 0;
+        } else {
+            ptrs[slot] = freelist_arenas_allocate(data->arenas, 16 + (state >> 32) % 512);
+            data->failed += ptrs[slot] == 0;
+        }
+    }
+    for (u64 i = 0; i < ARENAS_BENCH_SLOTS; i++) {
+        if (ptrs[i]) {
+            freelist_arenas_free(data->arenas, ptrs[i]);
+        }
+    }
+    return 0;
+}
+
+f64 run_arenas_bench(u32 arena_count, u32 thread_count, u64* out_failed) {
+    clock bench_clock;
+    freelist_arenas* arenas = freelist_arenas_create(arena_count, 4 * 1024 * 1024, FREELIST_ALLOCATOR_POLICY_TLSF);
+    arenas_bench_data data[ARENAS_THREADS];
+    zthread threads[ARENAS_THREADS];
+    clock_set(&bench_clock);
+    for (u32 i = 0; i < thread_count; i++) {
+        data[i].arenas = arenas;
+        data[i].seed = 0x9E3779B97F4A7C15ull * (i + 1);
+        data[i].failed = 0;
+        zthread_create(thread_freelist_arenas_bench, &data[i], &threads[i]);
+    }
+    zthread_wait_on_all(threads, thread_count);
+    clock_update(&bench_clock);
+    for (u32 i = 0; i < thread_count; i++) {
+        zthread_destroy(&threads[i]);
+        *out_failed += data[i].failed;
+    }
+    *out_failed += freelist_arenas_used_memory(arenas) != 0;
+    freelist_arenas_destroy(arenas);
+    return (f64)ARENAS_BENCH_OPS * thread_count / bench_clock.elapsed / 1000000.0;
+}
+
+u32 test_freelist_arenas_scaling_benchmark() {
+    u64 failed = 0;
+    for (u32 threads = 1; threads <= ARENAS_THREADS; threads++) {
+        // a single arena is the plain freelist_allocator behind one lock
+        f64 shared = run_arenas_bench(1, threads, &failed);
+        f64 per_thread = run_arenas_bench(threads, threads, &failed);
+        LOGT("freelist_arenas : %u threads, %f Mops/s on one arena, %f Mops/s on %u arenas", threads, shared, per_thread,
+             threads);
+    }
+    expect_should_be(0, failed);
+    return true;
+}
+
+void testing_freelist_arenas() {
+    test_manager_register_test(test_freelist_arenas_create_destroy, "test_freelist_arenas_create_destroy");
+    test_manager_register_test(test_freelist_arenas_alloc_free, "test_freelist_arenas_alloc_free");
+    test_manager_register_test(test_freelist_arenas_remote_free, "test_freelist_arenas_remote_free");
+    test_manager_register_test(test_freelist_arenas_scaling_benchmark, "test_freelist_arenas_scaling_benchmark");
+}
@@ -0,0 +1,6 @@
+#ifndef TESTING_FREELIST_ARENAS__H
+#define TESTING_FREELIST_ARENAS__H
+
+void testing_freelist_arenas();
+
+#endif
@@ -0,0 +1,206 @@
+#include "testing_object_cache.h"
+#include "expect.h"
+#include "test_manager.h"
+#include "zmemory.h"
+#include "zmutex.h"
+#include "clock.h"
+#include "logger.h"
+#include "object_cache.h"
+#include "pool_allocator.h"
+
+// stands in for objects that are expensive to set up
+typedef struct cached_object {
+    zmutex mutex;
+    u64 table[64];
+    u64 uses;
+} cached_object;
+
+static u64 ctor_calls;
+static u64 dtor_calls;
+
+bool cached_object_ctor(void* object) {
+    cached_object* obj = object;
+    if (!zmutex_create(&obj->mutex)) {
+        return false;
+    }
+    for (u64 i = 0; i < 64; i++) {
+        obj->table[i] = i * i * 2654435761ull;
+    }
+    obj->uses = 0;
+    ctor_calls += 1;
+    return true;
+}
+
+void cached_object_dtor(void* object) {
+    cached_object* obj = object;
+    zmutex_destroy(&obj->mutex);
+    dtor_calls += 1;
+}
+
+bool failing_ctor(void* object) {
+    (void)object;
+    return false;
+}
+
+u32 test_object_cache_create_destroy() {
+    object_cache* cache = object_cache_create(sizeof(cached_object), cached_object_ctor, cached_object_dtor);
+    expect_should_not_be(0, (u64)cache);
+    object_cache_destroy(cache);
+
+    expect_should_be(0, (u64)object_cache_create(0, 0, 0));
+    return true;
+}
+
+u32 test_object_cache_reuse() {
+    ctor_calls = 0;
+    dtor_calls = 0;
+    object_cache* cache = object_cache_create(sizeof(cached_object), cached_object_ctor, cached_object_dtor);
+
+    cached_object* objects[100];
+    for (u64 i = 0; i < 100; i++) {
+        objects[i] = object_cache_allocate(cache);
+        expect_should_not_be(0, (u64)objects[i]);
+        objects[i]->uses += 1;
+    }
+    expect_should_be(100ull, ctor_calls);
+
+    for (u64 i = 0; i < 100; i++) {
+        object_cache_free(cache, objects[i]);
+    }
+    expect_should_be(0ull, dtor_calls);
+    expect_should_be(100ull, object_cache_cached_count(cache));
+
+    // reused objects skip the ctor and keep the state they were freed with
+    for (u64 i = 0; i < 100; i++) {
+        objects[i] = object_cache_allocate(cache);
+        expect_should_be(1ull, objects[i]->uses);
+        expect_should_be(9ull * 9ull * 2654435761ull, objects[i]->table[9]);
+        zmutex_lock(&objects[i]->mutex);
+        zmutex_unlock(&objects[i]->mutex);
+    }
+    expect_should_be(100ull, ctor_calls);
+    expect_should_be(0ull, object_cache_cached_count(cache));
+
+    for (u64 i = 0; i < 100; i++) {
+        object_cache_free(cache, objects[i]);
+    }
+    object_cache_destroy(cache);
+    expect_should_be(100ull, dtor_calls);
+    return true;
+}
+
+u32 test_object_cache_reap() {
+    ctor_calls = 0;
+    dtor_calls = 0;
+    object_cache* cache = object_cache_create(sizeof(cached_object), cached_object_ctor, cached_object_dtor);
+
+    cached_object* kept = object_cache_allocate(cache);
+    cached_object* objects[50];
+    for (u64 i = 0; i < 50; i++) {
+        objects[i] = object_cache_allocate(cache);
+    }
+    for (u64 i = 0; i < 50; i++) {
+        object_cache_free(cache, objects[i]);
+    }
+
+    expect_should_be(50ull, object_cache_reap(cache));
+    expect_should_be(50ull, dtor_calls);
+    expect_should_be(0ull, object_cache_cached_count(cache));
+
+    // reaped memory is raw again, so the next allocation constructs
+    cached_object* fresh = object_cache_allocate(cache);
+    expect_should_be(52ull, ctor_calls);
+    expect_should_be(0ull, fresh->uses);
+
+    // objects still handed out are untouched by reap
+    expect_should_be(1ull, kept->table[1] / 2654435761ull);
+
+    object_cache_free(cache, fresh);
+    object_cache_free(cache, kept);
+    object_cache_destroy(cache);
+    expect_should_be(52ull, dtor_calls);
+    return true;
+}
+
+u32 test_object_cache_invalid() {
+    object_cache* cache = object_cache_create(24, 0, 0);
+
+    u64* object = object_cache_allocate(cache);
+    expect_should_not_be(0, (u64)object);
+    object_cache_free(cache, object);
+    // double free is rejected, the object is cached once
+    object_cache_free(cache, object);
+    expect_should_be(1ull, object_cache_cached_count(cache));
+    object_cache_free(cache, 0);
+
+    // a live object of another cache carries the same magic, the pool check turns it away
+    object_cache* other = object_cache_create(24, 0, 0);
+    u64* foreign = object_cache_allocate(other);
+    object_cache_free(cache, foreign);
+    expect_should_be(1ull, object_cache_cached_count(cache));
+    object_cache_free(other, foreign);
+    expect_should_be(1ull, object_cache_cached_count(other));
+    object_cache_destroy(other);
+
+    // memory no pool knows is never read
+    u64 outside[4] = {0, 0, 0, 0};
+    object_cache_free(cache, &outside[2]);
+    expect_should_be(1ull, object_cache_cached_count(cache));
+    object_cache_destroy(cache);
+
+    object_cache* failing = object_cache_create(24, failing_ctor, 0);
+    expect_should_be(0, (u64)object_cache_allocate(failing));
+    object_cache_destroy(failing);
+    return true;
+}
+
+u32 test_object_cache_benchmark() {
+    clock bench_clock;
+    const i32 num_objects = 1000;
+    const i32 rounds = 20;
+    cached_object* objects[1000];
+
+    // the pool has to run the setup/teardown on every round
+    pool_allocator* pool = pool_allocator_create(1024 * num_objects, 1024);
+    clock_set(&bench_clock);
+    for (i32 r = 0; r < rounds; r++) {
+        for (i32 i = 0; i < num_objects; i++) {
+            objects[i] = pool_allocator_allocate(pool);
+            if (!objects[i] || !cached_object_ctor(objects[i]))
+                return false;
+        }
+        for (i32 i = 0; i < num_objects; i++) {
+            cached_object_dtor(objects[i]);
+            pool_allocator_free(pool, objects[i]);
+        }
+    }
+    clock_update(&bench_clock);
+    LOGT("pool_allocator + ctor/dtor : %d rounds of %d objects: %f seconds", rounds, num_objects, bench_clock.elapsed);
+    pool_allocator_destroy(pool);
+
+    object_cache* cache = object_cache_create(sizeof(cached_object), cached_object_ctor, cached_object_dtor);
+    clock_set(&bench_clock);
+    for (i32 r = 0; r < rounds; r++) {
+        for (i32 i = 0; i < num_objects; i++) {
+            objects[i] = object_cache_allocate(cache);
+            if (!objects[i])
+                return false;
+        }
+        for (i32 i = 0; i < num_objects; i++) {
+            object_cache_free(cache, objects[i]);
+        }
+    }
+    clock_update(&bench_clock);
+    LOGT("object_cache : %d rounds of %d objects: %f seconds", rounds, num_objects, bench_clock.elapsed);
+    object_cache_destroy(cache);
+
+    return true;
+}
+
+void testing_object_cache() {
+    test_manager_register_test(test_object_cache_create_destroy, "test_object_cache_create_destroy");
+    test_manager_register_test(test_object_cache_reuse, "test_object_cache_reuse");
+    test_manager_register_test(test_object_cache_reap, "test_object_cache_reap");
+    test_manager_register_test(test_object_cache_invalid, "test_object_cache_invalid");
+    test_manager_register_test(test_object_cache_benchmark, "test_object_cache_benchmark");
+}
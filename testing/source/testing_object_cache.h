@@ -0,0 +1,6 @@
+#ifndef TESTING_OBJECT_CACHE__H
+#define TESTING_OBJECT_CACHE__H
+
+void testing_object_cache();
+
+#endif
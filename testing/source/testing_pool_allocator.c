@@ -1,3 +1,6 @@
+#ifdef __linux__
+#    define _GNU_SOURCE // O_DIRECT
+#endif
 #include "testing_pool_allocator.h"
 #include "zthread.h"
 #include "expect.h"
@@ -6,6 +9,15 @@
 #include "utils.h"
 #include "clock.h"
 #include "pool_allocator.h"
+#include "platform.h"
+#include "darray.h"
+
+#ifdef LINUX
+#    include <fcntl.h>
+#    include <stdio.h>
+#    include <stdlib.h>
+#    include <unistd.h>
+#endif
 
 // Test helper functions
 u32 verify_pool_block(void* ptr, u64 size) {
@@ -31,7 +43,7 @@ u32 test_pool_allocator_create_destroy() {
 }
 
 u32 test_pool_allocator_invalid_create() {
-    // Test non-power-of-two chunk size
+    // Test chunk size that is not a multiple of 8
     pool_allocator* allocator1 = pool_allocator_create(1024, 30);
     expect_should_be(0, (u64)allocator1);
 
@@ -53,7 +65,7 @@ u32 test_pool_allocator_basic_alloc_free() {
     expect_should_not_be(0, (u64)ptr);
 
     // Verify we can write to the full chunk size
-    if (!verify_pool_block(ptr, 32 - pool_allocator_header_size())) {
+    if (!verify_pool_block(ptr, 32 - pool_allocator_header_size(allocator))) {
         return false;
     }
 
@@ -146,6 +158,650 @@ u32 test_pool_allocator_reset() {
     return true;
 }
 
+// Create and reset must not touch the chunks
+u32 test_pool_allocator_lazy_carving() {
+    clock bench_clock;
+    const u64 size = 1024ull * 1024 * 1024; // 1GB, only the used pages get faulted in
+
+    clock_set(&bench_clock);
+    pool_allocator* allocator = pool_allocator_create(size, 64);
+    clock_update(&bench_clock);
+    expect_should_not_be(0, (u64)allocator);
+    LOGT("create time for a 1GB pool: %f seconds", bench_clock.elapsed);
+
+    void* ptrs[1000];
+    for (i32 i = 0; i < 1000; i++) {
+        ptrs[i] = pool_allocator_allocate(allocator);
+        expect_should_not_be(0, (u64)ptrs[i]);
+    }
+    // tail is carved in address order
+    expect_should_be(64, (u64)ptrs[1] - (u64)ptrs[0]);
+
+    pool_allocator_free(allocator, ptrs[10]);
+    expect_should_be((u64)ptrs[10], (u64)pool_allocator_allocate(allocator));
+
+    clock_set(&bench_clock);
+    pool_allocator_reset(allocator);
+    clock_update(&bench_clock);
+    LOGT("reset time for a 1GB pool: %f seconds", bench_clock.elapsed);
+
+    expect_should_be((u64)ptrs[0], (u64)pool_allocator_allocate(allocator));
+    pool_allocator_destroy(allocator);
+
+    // only whole chunks are carved from the tail
+    allocator = pool_allocator_create(1000, 32);
+    u64 count = 0;
+    while (pool_allocator_allocate(allocator)) {
+        count++;
+    }
+    expect_should_be(1000 / 32, count);
+    pool_allocator_destroy(allocator);
+
+    return true;
+}
+
+u32 test_pool_allocator_no_header() {
+    const u64 chunk_size = 32;
+    pool_allocator* allocator = pool_allocator_create_with_flags(1024, chunk_size, POOL_ALLOCATOR_FLAG_NO_HEADER);
+    expect_should_not_be(0, (u64)allocator);
+    expect_should_be(0, pool_allocator_header_size(allocator));
+
+    void* ptrs[32];
+    for (i32 i = 0; i < 32; i++) {
+        ptrs[i] = pool_allocator_allocate(allocator);
+        // the whole chunk is usable and chunks start on the chunk stride
+        if (!verify_pool_block(ptrs[i], chunk_size)) {
+            return false;
+        }
+        expect_should_be(0, (u64)ptrs[i] % chunk_size);
+    }
+    expect_should_be(0, (u64)pool_allocator_allocate(allocator));
+
+    // double free and a pointer inside a chunk are both rejected
+    pool_allocator_free(allocator, ptrs[3]);
+    pool_allocator_free(allocator, ptrs[3]);
+    pool_allocator_free(allocator, (u8*)ptrs[4] + 8);
+
+    expect_should_be((u64)ptrs[3], (u64)pool_allocator_allocate(allocator));
+    expect_should_be(0, (u64)pool_allocator_allocate(allocator));
+
+    for (i32 i = 0; i < 32; i++) {
+        pool_allocator_free(allocator, ptrs[i]);
+    }
+    pool_allocator_reset(allocator);
+    pool_allocator_destroy(allocator);
+
+    // pointer sized chunks are enough without a header
+    allocator = pool_allocator_create_with_flags(1024, 8, POOL_ALLOCATOR_FLAG_NO_HEADER | POOL_ALLOCATOR_FLAG_LOCK_FREE);
+    expect_should_not_be(0, (u64)allocator);
+    u64 count = 0;
+    while (pool_allocator_allocate(allocator)) {
+        count++;
+    }
+    expect_should_be(1024 / 8, count);
+    pool_allocator_destroy(allocator);
+
+    return true;
+}
+
+u32 test_pool_allocator_growable() {
+    // 4KB slabs of 64 byte chunks, the slab header and its occupancy bitmap take the first two chunk slots
+    pool_allocator* allocator = pool_allocator_create_with_flags(4096, 64, POOL_ALLOCATOR_FLAG_GROWABLE);
+    expect_should_not_be(0, (u64)allocator);
+    expect_should_be(0, pool_allocator_slab_count(allocator));
+
+    void* ptrs[1000];
+    for (i32 i = 0; i < 1000; i++) {
+        ptrs[i] = pool_allocator_allocate(allocator);
+        if (!verify_pool_block(ptrs[i], 64 - pool_allocator_header_size(allocator))) {
+            return false;
+        }
+        zmemory_set(ptrs[i], (u8)i, 64 - pool_allocator_header_size(allocator));
+    }
+    expect_should_be(1000ull / 62 + 1, pool_allocator_slab_count(allocator));
+
+    // no chunk was handed out twice
+    for (i32 i = 0; i < 1000; i++) {
+        expect_should_be((u8)i, *(u8*)ptrs[i]);
+    }
+
+    char dummy;
+    pool_allocator_free(allocator, &dummy);
+
+    // one completely free slab is kept by default, the rest go back to the OS
+    for (i32 i = 0; i < 1000; i++) {
+        pool_allocator_free(allocator, ptrs[i]);
+    }
+    expect_should_be(1ull, pool_allocator_slab_count(allocator));
+
+    pool_allocator_set_slab_watermark(allocator, 0);
+    expect_should_be(0, pool_allocator_slab_count(allocator));
+
+    for (i32 i = 0; i < 200; i++) {
+        ptrs[i] = pool_allocator_allocate(allocator);
+        expect_should_not_be(0, (u64)ptrs[i]);
+    }
+    pool_allocator_reset(allocator);
+    expect_should_be(0, pool_allocator_slab_count(allocator));
+    pool_allocator_destroy(allocator);
+
+    // header free chunks keep their occupancy bitmap inside the slab
+    allocator = pool_allocator_create_with_flags(4096, 16, POOL_ALLOCATOR_FLAG_GROWABLE | POOL_ALLOCATOR_FLAG_NO_HEADER);
+    expect_should_not_be(0, (u64)allocator);
+    for (i32 i = 0; i < 1000; i++) {
+        ptrs[i] = pool_allocator_allocate(allocator);
+        expect_should_not_be(0, (u64)ptrs[i]);
+    }
+    pool_allocator_free(allocator, ptrs[0]);
+    pool_allocator_free(allocator, ptrs[0]);
+    expect_should_be((u64)ptrs[0], (u64)pool_allocator_allocate(allocator));
+    pool_allocator_destroy(allocator);
+
+    // slabs are unmapped one by one, the tagged head can not follow
+    allocator = pool_allocator_create_with_flags(4096, 64, POOL_ALLOCATOR_FLAG_GROWABLE | POOL_ALLOCATOR_FLAG_LOCK_FREE);
+    expect_should_be(0, (u64)allocator);
+
+    return true;
+}
+
+u32 test_pool_allocator_batch() {
+    const pool_allocator_flags modes[] = {
+        POOL_ALLOCATOR_FLAG_NONE,
+        POOL_ALLOCATOR_FLAG_LOCK_FREE,
+        POOL_ALLOCATOR_FLAG_NO_HEADER | POOL_ALLOCATOR_FLAG_LOCK_FREE,
+        POOL_ALLOCATOR_FLAG_THREAD_CACHE,
+    };
+
+    for (u64 m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        pool_allocator* allocator = pool_allocator_create_with_flags(1024, 32, modes[m]);
+        void* ptrs[40];
+
+        // asking for more than the pool holds returns what is there
+        expect_should_be(32ull, pool_allocator_allocate_batch(allocator, ptrs, 40));
+        for (u64 i = 0; i < 32; i++) {
+            zmemory_set(ptrs[i], (u8)i, 32 - pool_allocator_header_size(allocator));
+        }
+        for (u64 i = 0; i < 32; i++) {
+            expect_should_be((u8)i, *(u8*)ptrs[i]);
+        }
+
+        pool_allocator_free_batch(allocator, ptrs, 16);
+        pool_allocator_free_batch(allocator, ptrs + 16, 16);
+
+        // everything came back, and a spliced sublist pops like any other
+        expect_should_be(32ull, pool_allocator_allocate_batch(allocator, ptrs, 32));
+        expect_should_be(0, (u64)pool_allocator_allocate(allocator));
+        pool_allocator_free_batch(allocator, ptrs, 32);
+
+        pool_allocator_destroy(allocator);
+    }
+
+    // growable pools map as many slabs as the batch needs
+    pool_allocator* allocator = pool_allocator_create_with_flags(4096, 64, POOL_ALLOCATOR_FLAG_GROWABLE);
+    void* ptrs[200];
+    expect_should_be(200ull, pool_allocator_allocate_batch(allocator, ptrs, 200));
+    pool_allocator_free_batch(allocator, ptrs, 200);
+    expect_should_be(1ull, pool_allocator_slab_count(allocator));
+    pool_allocator_destroy(allocator);
+
+    return true;
+}
+
+u32 test_pool_allocator_in_place() {
+    // 48 byte chunks, not a power of two, over caller owned memory
+    u64 block[48 * 20 / sizeof(u64)];
+    const pool_allocator_flags modes[] = {
+        POOL_ALLOCATOR_FLAG_NONE,
+        POOL_ALLOCATOR_FLAG_LOCK_FREE,
+        POOL_ALLOCATOR_FLAG_NO_HEADER,
+    };
+
+    for (u64 m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        pool_allocator* allocator = pool_allocator_create_in_place(block, sizeof(block), 48, modes[m]);
+        expect_should_not_be(0, (u64)allocator);
+
+        void* ptrs[20];
+        for (u64 i = 0; i < 20; i++) {
+            ptrs[i] = pool_allocator_allocate(allocator);
+            expect_should_be((u64)block + i * 48 + pool_allocator_header_size(allocator), (u64)ptrs[i]);
+        }
+        expect_should_be(0, (u64)pool_allocator_allocate(allocator));
+
+        // off stride pointers are rejected
+        pool_allocator_free(allocator, (u8*)ptrs[3] + 16);
+        pool_allocator_free(allocator, ptrs[3]);
+        expect_should_be((u64)ptrs[3], (u64)pool_allocator_allocate(allocator));
+
+        pool_allocator_destroy(allocator);
+    }
+
+    expect_should_be(0, (u64)pool_allocator_create_in_place(0, 1024, 48, POOL_ALLOCATOR_FLAG_NONE));
+    expect_should_be(0, (u64)pool_allocator_create_in_place(block, sizeof(block), 48, POOL_ALLOCATOR_FLAG_GROWABLE));
+
+    // growable pools take odd chunk sizes as well
+    pool_allocator* allocator = pool_allocator_create_with_flags(4096, 48, POOL_ALLOCATOR_FLAG_GROWABLE | POOL_ALLOCATOR_FLAG_NO_HEADER);
+    void* ptrs[100];
+    for (u64 i = 0; i < 100; i++) {
+        ptrs[i] = pool_allocator_allocate(allocator);
+        expect_should_not_be(0, (u64)ptrs[i]);
+    }
+    for (u64 i = 0; i < 100; i++) {
+        pool_allocator_free(allocator, ptrs[i]);
+    }
+    pool_allocator_destroy(allocator);
+
+    return true;
+}
+
+typedef struct live_walk {
+    u64 visited;
+    u64 last;
+    u64 sum;
+    bool ordered;
+    u64 stop_after;
+} live_walk;
+
+bool live_walk_visit(void* block, void* ctx) {
+    live_walk* walk = ctx;
+    walk->ordered = walk->ordered && (u64)block > walk->last;
+    walk->last = (u64)block;
+    walk->sum += *(u64*)block;
+    walk->visited += 1;
+    return walk->visited != walk->stop_after;
+}
+
+u32 test_pool_allocator_for_each_live() {
+    const pool_allocator_flags modes[] = {
+        POOL_ALLOCATOR_FLAG_NONE,
+        POOL_ALLOCATOR_FLAG_NO_HEADER,
+        POOL_ALLOCATOR_FLAG_LOCK_FREE,
+        POOL_ALLOCATOR_FLAG_THREAD_CACHE,
+        POOL_ALLOCATOR_FLAG_GROWABLE,
+    };
+
+    for (u64 m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        pool_allocator* allocator = pool_allocator_create_with_flags(32 * 256, 32, modes[m]);
+        void* ptrs[200];
+        u64 expected_sum = 0;
+        u64 expected_live = 0;
+        for (u64 i = 0; i < 200; i++) {
+            ptrs[i] = pool_allocator_allocate(allocator);
+            *(u64*)ptrs[i] = i;
+        }
+        // punch holes, including whole 64 chunk groups
+        for (u64 i = 0; i < 200; i++) {
+            if (i % 3 == 0 || (i >= 64 && i < 128)) {
+                pool_allocator_free(allocator, ptrs[i]);
+            } else {
+                expected_sum += i;
+                expected_live += 1;
+            }
+        }
+
+        live_walk walk = {0, 0, 0, true, 0};
+        expect_should_be(expected_live, pool_allocator_for_each_live(allocator, live_walk_visit, &walk));
+        expect_should_be(expected_live, walk.visited);
+        expect_should_be(expected_sum, walk.sum);
+        expect_should_be(true, walk.ordered);
+        expect_should_be(expected_live, pool_allocator_live_count(allocator));
+
+        // returning false stops the walk
+        live_walk partial = {0, 0, 0, true, 10};
+        expect_should_be(10ull, pool_allocator_for_each_live(allocator, live_walk_visit, &partial));
+
+        pool_allocator_reset(allocator);
+        expect_should_be(0ull, pool_allocator_live_count(allocator));
+        pool_allocator_destroy(allocator);
+    }
+
+    // the bitmap also catches double frees in pools with headers
+    pool_allocator* allocator = pool_allocator_create(1024, 32);
+    void* ptr = pool_allocator_allocate(allocator);
+    pool_allocator_free(allocator, ptr);
+    pool_allocator_free(allocator, ptr);
+    expect_should_be((u64)ptr, (u64)pool_allocator_allocate(allocator));
+    expect_should_not_be((u64)ptr, (u64)pool_allocator_allocate(allocator));
+    pool_allocator_destroy(allocator);
+
+    return true;
+}
+
+bool live_sum_visit(void* block, void* ctx) {
+    *(u64*)ctx += *(u64*)block;
+    return true;
+}
+
+u32 test_pool_allocator_iteration_benchmark() {
+    clock bench_clock;
+    const u64 num_chunks = 100000;
+    pool_allocator* allocator = pool_allocator_create(64 * num_chunks, 64);
+    void** ptrs = zmemory_allocate(sizeof(void*) * num_chunks);
+    for (u64 i = 0; i < num_chunks; i++) {
+        ptrs[i] = pool_allocator_allocate(allocator);
+        *(u64*)ptrs[i] = i;
+    }
+
+    // one entity in ten survives, in runs so some 64 chunk groups empty out completely
+    void** live = darray_create(void*);
+    for (u64 i = 0; i < num_chunks; i++) {
+        if ((i / 640) % 2 == 0 && i % 5 == 0) {
+            darray_push_back(live, ptrs[i]);
+        } else {
+            pool_allocator_free(allocator, ptrs[i]);
+        }
+    }
+
+    u64 darray_sum = 0;
+    clock_set(&bench_clock);
+    for (u64 i = 0; i < darray_size(live); i++) {
+        darray_sum += *(u64*)live[i];
+    }
+    clock_update(&bench_clock);
+    LOGT("darray of live pointers : %llu live of %llu chunks: %f seconds", darray_size(live), num_chunks, bench_clock.elapsed);
+
+    u64 walk_sum = 0;
+    clock_set(&bench_clock);
+    pool_allocator_for_each_live(allocator, live_sum_visit, &walk_sum);
+    clock_update(&bench_clock);
+    LOGT("pool_allocator_for_each_live : %llu live of %llu chunks: %f seconds", darray_size(live), num_chunks, bench_clock.elapsed);
+
+    expect_should_be(darray_sum, walk_sum);
+
+    darray_destroy(live);
+    zmemory_free(ptrs, sizeof(void*) * num_chunks);
+    pool_allocator_destroy(allocator);
+    return true;
+}
+
+u32 test_pool_allocator_handles() {
+    const pool_allocator_flags modes[] = {
+        POOL_ALLOCATOR_FLAG_HANDLES,
+        POOL_ALLOCATOR_FLAG_HANDLES | POOL_ALLOCATOR_FLAG_NO_HEADER,
+        POOL_ALLOCATOR_FLAG_HANDLES | POOL_ALLOCATOR_FLAG_NO_HEADER | POOL_ALLOCATOR_FLAG_LOCK_FREE,
+        POOL_ALLOCATOR_FLAG_HANDLES | POOL_ALLOCATOR_FLAG_NO_HEADER | POOL_ALLOCATOR_FLAG_THREAD_CACHE,
+    };
+
+    for (u64 m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        pool_allocator* allocator = pool_allocator_create_with_flags(1024, 32, modes[m]);
+        expect_should_not_be(0, (u64)allocator);
+
+        pool_handle first = pool_allocator_allocate_handle(allocator);
+        u64* ptr = pool_allocator_resolve(allocator, first);
+        expect_should_not_be(0, (u64)ptr);
+        *ptr = 42;
+        pool_handle same = pool_allocator_handle_of(allocator, ptr);
+        expect_should_be(first.index, same.index);
+        expect_should_be(first.generation, same.generation);
+
+        // the chunk is reused, the old handle stays dead
+        pool_allocator_free_handle(allocator, first);
+        expect_should_be(0, (u64)pool_allocator_resolve(allocator, first));
+        pool_handle second = pool_allocator_allocate_handle(allocator);
+        expect_should_be(first.index, second.index);
+        expect_should_not_be(first.generation, second.generation);
+        expect_should_be(0, (u64)pool_allocator_resolve(allocator, first));
+        expect_should_be((u64)ptr, (u64)pool_allocator_resolve(allocator, second));
+
+        // freeing through the stale handle must not free the new owner
+        pool_allocator_free_handle(allocator, first);
+        expect_should_be((u64)ptr, (u64)pool_allocator_resolve(allocator, second));
+
+        // frees through the pointer kill the handle as well
+        pool_allocator_free(allocator, ptr);
+        expect_should_be(0, (u64)pool_allocator_resolve(allocator, second));
+
+        pool_handle zero = {0, 0};
+        expect_should_be(0, (u64)pool_allocator_resolve(allocator, zero));
+        pool_handle out_of_range = {1000, 1};
+        expect_should_be(0, (u64)pool_allocator_resolve(allocator, out_of_range));
+
+        pool_handle live = pool_allocator_allocate_handle(allocator);
+        pool_allocator_reset(allocator);
+        expect_should_be(0, (u64)pool_allocator_resolve(allocator, live));
+
+        // reset does not touch the generations, carving the chunk again is what retires the old one
+        pool_handle reborn = pool_allocator_allocate_handle(allocator);
+        expect_should_be(live.index, reborn.index);
+        expect_should_not_be(live.generation, reborn.generation);
+        expect_should_be(0, (u64)pool_allocator_resolve(allocator, live));
+        pool_allocator_free_handle(allocator, live);
+        expect_should_not_be(0, (u64)pool_allocator_resolve(allocator, reborn));
+
+        pool_allocator_destroy(allocator);
+    }
+
+    expect_should_be(0, (u64)pool_allocator_create_with_flags(4096, 32, POOL_ALLOCATOR_FLAG_HANDLES | POOL_ALLOCATOR_FLAG_GROWABLE));
+
+    // pools without the flag have no generations to check against
+    pool_allocator* allocator = pool_allocator_create(1024, 32);
+    pool_handle handle = pool_allocator_allocate_handle(allocator);
+    expect_should_be(0u, handle.generation);
+    pool_allocator_destroy(allocator);
+
+    return true;
+}
+
+u32 test_pool_allocator_cache_color() {
+    pool_allocator_stats stats[2];
+    pool_allocator* allocators[2];
+    for (u64 i = 0; i < 2; i++) {
+        allocators[i] = pool_allocator_create_with_flags(1024, 32, POOL_ALLOCATOR_FLAG_CACHE_COLOR);
+        pool_allocator_get_stats(allocators[i], &stats[i]);
+        expect_should_be(64ull, stats[i].color_stride);
+        expect_should_be(platform_page_size() / 64, stats[i].color_count);
+    }
+    // consecutive pools start one cache line apart
+    expect_should_be((stats[0].color + 64) % platform_page_size(), stats[1].color);
+
+    for (u64 i = 0; i < 2; i++) {
+        // the color costs no capacity
+        u64 first_offset = (u64)pool_allocator_allocate(allocators[i]) & (platform_page_size() - 1);
+        expect_should_be(stats[i].color + pool_allocator_header_size(allocators[i]), first_offset);
+        for (u64 j = 1; j < 32; j++) {
+            expect_should_not_be(0, (u64)pool_allocator_allocate(allocators[i]));
+        }
+        expect_should_be(0, (u64)pool_allocator_allocate(allocators[i]));
+        pool_allocator_destroy(allocators[i]);
+    }
+
+    // growable slabs cycle through the slack, a power of two chunk gives one chunk up for it
+    pool_allocator* allocator = pool_allocator_create_with_flags(4096, 64, POOL_ALLOCATOR_FLAG_GROWABLE | POOL_ALLOCATOR_FLAG_CACHE_COLOR);
+    pool_allocator_stats growable;
+    pool_allocator_get_stats(allocator, &growable);
+    expect_should_be(61ull, growable.chunk_count);
+    expect_should_be(2ull, growable.color_count);
+    u64 offsets[2];
+    for (u64 slab = 0; slab < 2; slab++) {
+        for (u64 j = 0; j < growable.chunk_count; j++) {
+            void* ptr = pool_allocator_allocate(allocator);
+            if (j == 0) {
+                offsets[slab] = (u64)ptr & 4095;
+            }
+        }
+    }
+    u64 offset_delta = offsets[0] > offsets[1] ? offsets[0] - offsets[1] : offsets[1] - offsets[0];
+    expect_should_be(64ull, offset_delta);
+    pool_allocator_destroy(allocator);
+
+    // pools without the flag report no coloring
+    allocator = pool_allocator_create(1024, 32);
+    pool_allocator_stats plain;
+    pool_allocator_get_stats(allocator, &plain);
+    expect_should_be(0ull, plain.color_stride);
+    expect_should_be(32ull, plain.chunk_count);
+    pool_allocator_destroy(allocator);
+
+    return true;
+}
+
+#define COLOR_BENCH_POOLS 16
+#define COLOR_BENCH_CHUNKS 8
+
+u64 color_bench_walk(pool_allocator_flags flags, f64* out_elapsed) {
+    clock bench_clock;
+    pool_allocator* allocators[COLOR_BENCH_POOLS];
+    u64* chunks[COLOR_BENCH_POOLS][COLOR_BENCH_CHUNKS];
+    for (u64 p = 0; p < COLOR_BENCH_POOLS; p++) {
+        allocators[p] = pool_allocator_create_with_flags(256 * COLOR_BENCH_CHUNKS, 256, flags | POOL_ALLOCATOR_FLAG_NO_HEADER);
+        for (u64 c = 0; c < COLOR_BENCH_CHUNKS; c++) {
+            chunks[p][c] = pool_allocator_allocate(allocators[p]);
+            *chunks[p][c] = p + c;
+        }
+    }
+
+    // chunk c of every pool in lockstep, uncolored pools put all of them on the same cache set
+    u64 sum = 0;
+    clock_set(&bench_clock);
+    for (u64 round = 0; round < 20000; round++) {
+        for (u64 c = 0; c < COLOR_BENCH_CHUNKS; c++) {
+            for (u64 p = 0; p < COLOR_BENCH_POOLS; p++) {
+                sum += *(volatile u64*)chunks[p][c];
+            }
+        }
+    }
+    clock_update(&bench_clock);
+    *out_elapsed = bench_clock.elapsed;
+
+    for (u64 p = 0; p < COLOR_BENCH_POOLS; p++) {
+        pool_allocator_destroy(allocators[p]);
+    }
+    return sum;
+}
+
+u32 test_pool_allocator_cache_color_benchmark() {
+    f64 plain_elapsed;
+    f64 colored_elapsed;
+    u64 plain_sum = color_bench_walk(POOL_ALLOCATOR_FLAG_NONE, &plain_elapsed);
+    u64 colored_sum = color_bench_walk(POOL_ALLOCATOR_FLAG_CACHE_COLOR, &colored_elapsed);
+    LOGT("lockstep walk over %d pools, uncolored : %f seconds", COLOR_BENCH_POOLS, plain_elapsed);
+    LOGT("lockstep walk over %d pools, colored : %f seconds", COLOR_BENCH_POOLS, colored_elapsed);
+    expect_should_be(plain_sum, colored_sum);
+    return true;
+}
+
+u32 test_pool_allocator_page_aligned() {
+    const u64 page = platform_page_size();
+    pool_allocator* allocator = pool_allocator_create_with_flags(page * 16, page, POOL_ALLOCATOR_FLAG_PAGE_ALIGNED);
+    expect_should_not_be(0, (u64)allocator);
+    expect_should_be(0, pool_allocator_header_size(allocator));
+    void* ptrs[16];
+    for (u64 i = 0; i < 16; i++) {
+        ptrs[i] = pool_allocator_allocate(allocator);
+        expect_should_not_be(0, (u64)ptrs[i]);
+        u64 misalignment = (u64)ptrs[i] & (page - 1);
+        expect_should_be(0, misalignment);
+    }
+    expect_should_be(0, (u64)pool_allocator_allocate(allocator));
+    pool_allocator_free_batch(allocator, ptrs, 16);
+    expect_should_be(0, pool_allocator_live_count(allocator));
+    pool_allocator_destroy(allocator);
+
+    // growable slabs give their first page to the slab header
+    allocator = pool_allocator_create_with_flags(page * 4, page, POOL_ALLOCATOR_FLAG_PAGE_ALIGNED | POOL_ALLOCATOR_FLAG_GROWABLE);
+    for (u64 i = 0; i < 7; i++) {
+        void* ptr = pool_allocator_allocate(allocator);
+        expect_should_not_be(0, (u64)ptr);
+        u64 misalignment = (u64)ptr & (page - 1);
+        expect_should_be(0, misalignment);
+    }
+    expect_should_be(3ull, pool_allocator_slab_count(allocator));
+    pool_allocator_destroy(allocator);
+
+    expect_should_be(0, (u64)pool_allocator_create_with_flags(page * 16, page + 8, POOL_ALLOCATOR_FLAG_PAGE_ALIGNED));
+    expect_should_be(0, (u64)pool_allocator_create_with_flags(page * 16, page, POOL_ALLOCATOR_FLAG_PAGE_ALIGNED | POOL_ALLOCATOR_FLAG_CACHE_COLOR));
+    u8* block = zmemory_allocate_pages(page * 4);
+    expect_should_be(0, (u64)pool_allocator_create_in_place(block + 64, page * 3, page, POOL_ALLOCATOR_FLAG_PAGE_ALIGNED));
+    allocator = pool_allocator_create_in_place(block, page * 4, page, POOL_ALLOCATOR_FLAG_PAGE_ALIGNED);
+    expect_should_be((u64)block, (u64)pool_allocator_allocate(allocator));
+    pool_allocator_destroy(allocator);
+    zmemory_free_pages(block, page * 4);
+    return true;
+}
+
+#ifdef LINUX
+#    define DIRECT_IO_FILE_SIZE (32ull * 1024 * 1024)
+#    define DIRECT_IO_BUFFER_SIZE (256ull * 1024)
+
+u32 test_pool_allocator_direct_io_benchmark() {
+    clock bench_clock;
+    const u64 buffer_count = DIRECT_IO_FILE_SIZE / DIRECT_IO_BUFFER_SIZE;
+    pool_allocator* allocator = pool_allocator_create_with_flags(DIRECT_IO_BUFFER_SIZE * 8, DIRECT_IO_BUFFER_SIZE, POOL_ALLOCATOR_FLAG_PAGE_ALIGNED);
+
+    // the scratch file lives in the temp directory, never in whatever directory the tests run from
+    const char* temp_dir = getenv("TMPDIR");
+    char path[512];
+    snprintf(path, sizeof(path), "%s/pool_direct_io_XXXXXX", temp_dir && temp_dir[0] ? temp_dir : "/tmp");
+
+    // every buffer of the file starts with its own index
+    i32 fd = mkstemp(path);
+    if (fd < 0) {
+        LOGW("test_pool_allocator_direct_io_benchmark : failed to create %s", path);
+        pool_allocator_destroy(allocator);
+        return TEST_SKIPPED;
+    }
+    u64* pattern = pool_allocator_allocate(allocator);
+    zmemory_set_zero(pattern, DIRECT_IO_BUFFER_SIZE);
+    bool written = true;
+    for (u64 i = 0; i < buffer_count && written; i++) {
+        pattern[0] = i;
+        written = write(fd, pattern, DIRECT_IO_BUFFER_SIZE) == (i64)DIRECT_IO_BUFFER_SIZE;
+    }
+    pool_allocator_free(allocator, pattern);
+    fsync(fd);
+    close(fd);
+
+    // tmpfs and some other filesystems refuse O_DIRECT
+    fd = written ? open(path, O_RDONLY | O_DIRECT) : -1;
+    if (fd < 0) {
+        LOGW("test_pool_allocator_direct_io_benchmark : O_DIRECT is not available here");
+        unlink(path);
+        pool_allocator_destroy(allocator);
+        return TEST_SKIPPED;
+    }
+
+    // pooled chunks are valid O_DIRECT targets, the data lands where it is consumed
+    u64 pooled_sum = 0;
+    bool pooled_ok = true;
+    clock_set(&bench_clock);
+    for (u64 i = 0; i < buffer_count && pooled_ok; i++) {
+        u64* buffer = pool_allocator_allocate(allocator);
+        pooled_ok = pread(fd, buffer, DIRECT_IO_BUFFER_SIZE, i * DIRECT_IO_BUFFER_SIZE) == (i64)DIRECT_IO_BUFFER_SIZE;
+        pooled_sum += buffer[0];
+        pool_allocator_free(allocator, buffer);
+    }
+    clock_update(&bench_clock);
+    f64 pooled_elapsed = bench_clock.elapsed;
+
+    // zmemory_allocate makes no alignment promise, so every read goes through an aligned bounce buffer first
+    u64 bounce_sum = 0;
+    bool bounce_ok = true;
+    void* bounce = pool_allocator_allocate(allocator);
+    clock_set(&bench_clock);
+    for (u64 i = 0; i < buffer_count && bounce_ok; i++) {
+        u64* buffer = zmemory_allocate(DIRECT_IO_BUFFER_SIZE);
+        bounce_ok = pread(fd, bounce, DIRECT_IO_BUFFER_SIZE, i * DIRECT_IO_BUFFER_SIZE) == (i64)DIRECT_IO_BUFFER_SIZE;
+        zmemory_copy(buffer, bounce, DIRECT_IO_BUFFER_SIZE);
+        bounce_sum += buffer[0];
+        zmemory_free(buffer, DIRECT_IO_BUFFER_SIZE);
+    }
+    clock_update(&bench_clock);
+    f64 bounce_elapsed = bench_clock.elapsed;
+    pool_allocator_free(allocator, bounce);
+
+    close(fd);
+    unlink(path);
+    pool_allocator_destroy(allocator);
+
+    LOGT("O_DIRECT read of %llu MiB into page aligned pool chunks : %f seconds", DIRECT_IO_FILE_SIZE >> 20, pooled_elapsed);
+    LOGT("O_DIRECT read of %llu MiB through a bounce buffer into zmemory_allocate : %f seconds", DIRECT_IO_FILE_SIZE >> 20, bounce_elapsed);
+    expect_should_be(true, pooled_ok);
+    expect_should_be(true, bounce_ok);
+    expect_should_be(buffer_count * (buffer_count - 1) / 2, pooled_sum);
+    expect_should_be(pooled_sum, bounce_sum);
+    return true;
+}
+#endif
+
 // Multithreading test structures
 #define NUM_THREADS 4
 #define ALLOCS_PER_THREAD 100
@@ -169,7 +825,7 @@ void* thread_pool_alloc_free(void* arg) {
         void* ptr = pool_allocator_allocate(data->allocator);
         if (ptr) {
             ptrs[allocated++] = ptr;
-            if (!verify_pool_block(ptr, 32 - pool_allocator_header_size())) {
+            if (!verify_pool_block(ptr, 32 - pool_allocator_header_size(data->allocator))) {
                 data->success = false;
 #ifdef WINDOWS
                 return 0;
@@ -221,6 +877,292 @@ u32 test_pool_allocator_multithreaded() {
     return true;
 }
 
+#define HANDLE_RACE_CHUNKS 256
+#define HANDLE_RACE_ROUNDS 2000
+
+typedef struct {
+    pool_allocator* allocator;
+    void** blocks;
+    pool_handle* handles;
+    bool through_handle;
+} handle_race_data;
+
+#ifdef WINDOWS
+u32 thread_pool_handle_race(void* arg) {
+#else
+void* thread_pool_handle_race(void* arg) {
+#endif
+    handle_race_data* data = (handle_race_data*)arg;
+    for (u64 i = 0; i < HANDLE_RACE_CHUNKS; i++) {
+        if (data->through_handle) {
+            pool_allocator_free_handle(data->allocator, data->handles[i]);
+        } else {
+            pool_allocator_free(data->allocator, data->blocks[i]);
+        }
+    }
+    return 0;
+}
+
+// a pointer free and a handle free of the same chunk race, exactly one may win and the chunk must end up
+// free with an even generation, otherwise it is handed out twice or its next handle is born dead
+u32 test_pool_allocator_handle_free_race() {
+    const pool_allocator_flags modes[] = {
+        POOL_ALLOCATOR_FLAG_HANDLES,
+        POOL_ALLOCATOR_FLAG_HANDLES | POOL_ALLOCATOR_FLAG_NO_HEADER | POOL_ALLOCATOR_FLAG_LOCK_FREE,
+    };
+    void* blocks[HANDLE_RACE_CHUNKS];
+    pool_handle handles[HANDLE_RACE_CHUNKS];
+    u64 failed = 0;
+
+    for (u64 m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        pool_allocator* allocator = pool_allocator_create_with_flags(HANDLE_RACE_CHUNKS * 32, 32, modes[m]);
+        expect_should_not_be(0, (u64)allocator);
+        for (u64 round = 0; round < HANDLE_RACE_ROUNDS; round++) {
+            for (u64 i = 0; i < HANDLE_RACE_CHUNKS; i++) {
+                handles[i] = pool_allocator_allocate_handle(allocator);
+                blocks[i] = pool_allocator_resolve(allocator, handles[i]);
+                failed += blocks[i] == 0;
+            }
+            handle_race_data data[2] = {
+                {allocator, blocks, handles, false},
+                {allocator, blocks, handles, true},
+            };
+            zthread threads[2];
+            zthread_create(thread_pool_handle_race, &data[0], &threads[0]);
+            zthread_create(thread_pool_handle_race, &data[1], &threads[1]);
+            zthread_wait_on_all(threads, 2);
+            zthread_destroy(&threads[0]);
+            zthread_destroy(&threads[1]);
+            failed += pool_allocator_live_count(allocator) != 0;
+        }
+        // every chunk is on the freelist once, and every new handle resolves
+        for (u64 i = 0; i < HANDLE_RACE_CHUNKS; i++) {
+            handles[i] = pool_allocator_allocate_handle(allocator);
+            failed += pool_allocator_resolve(allocator, handles[i]) == 0;
+        }
+        failed += pool_allocator_allocate(allocator) != 0;
+        pool_allocator_destroy(allocator);
+    }
+
+    expect_should_be(0, failed);
+    return true;
+}
+
+typedef struct {
+    pool_allocator* allocator;
+    u8 pattern;
+    u32 success;
+} lock_free_thread_data;
+
+#ifdef WINDOWS
+u32 thread_pool_lock_free_alloc_free(void* arg) {
+#else
+void* thread_pool_lock_free_alloc_free(void* arg) {
+#endif
+    lock_free_thread_data* data = (lock_free_thread_data*)arg;
+    const u64 usable = 32 - pool_allocator_header_size(data->allocator);
+    void* ptrs[ALLOCS_PER_THREAD];
+
+    for (i32 round = 0; round < 100; round++) {
+        i32 allocated = 0;
+        for (i32 i = 0; i < ALLOCS_PER_THREAD; i++) {
+            void* ptr = pool_allocator_allocate(data->allocator);
+            if (ptr) {
+                zmemory_set(ptr, data->pattern, usable);
+                ptrs[allocated++] = ptr;
+            }
+        }
+        // a chunk handed to two threads at once would have its pattern overwritten
+        for (i32 i = allocated - 1; i >= 0; i--) {
+            u8* bytes = (u8*)ptrs[i];
+            for (u64 j = 0; j < usable; j++) {
+                if (bytes[j] != data->pattern) {
+                    data->success = false;
+                    return 0;
+                }
+            }
+            pool_allocator_free(data->allocator, ptrs[i]);
+        }
+    }
+
+    data->success = true;
+    return 0;
+}
+
+u32 test_pool_allocator_lock_free_multithreaded() {
+    // small pool so the threads keep fighting over the same chunks
+    pool_allocator* allocator = pool_allocator_create_with_flags(32 * ALLOCS_PER_THREAD * 2, 32, POOL_ALLOCATOR_FLAG_LOCK_FREE);
+    expect_should_not_be(0, (u64)allocator);
+
+    lock_free_thread_data thread_args[NUM_THREADS];
+    zthread threads[NUM_THREADS];
+
+    for (i32 i = 0; i < NUM_THREADS; i++) {
+        thread_args[i].allocator = allocator;
+        thread_args[i].pattern = (u8)(i + 1);
+        thread_args[i].success = false;
+        if (!zthread_create(thread_pool_lock_free_alloc_free, &thread_args[i], &threads[i])) {
+            return false;
+        }
+    }
+
+    if (!zthread_wait_on_all(threads, NUM_THREADS)) {
+        return false;
+    }
+
+    for (i32 i = 0; i < NUM_THREADS; i++) {
+        if (!thread_args[i].success) {
+            return false;
+        }
+        zthread_destroy(&threads[i]);
+    }
+
+    // every chunk must be back on the freelist
+    void* ptrs[ALLOCS_PER_THREAD * 2];
+    i32 count = 0;
+    while (count < ALLOCS_PER_THREAD * 2 && (ptrs[count] = pool_allocator_allocate(allocator)) != 0) {
+        count++;
+    }
+    expect_should_be(ALLOCS_PER_THREAD * 2, count);
+
+    pool_allocator_destroy(allocator);
+    return true;
+}
+
+u32 test_pool_allocator_thread_cache() {
+    const u64 chunk_count = ALLOCS_PER_THREAD * 4;
+    pool_allocator* allocator = pool_allocator_create_with_flags(32 * chunk_count, 32, POOL_ALLOCATOR_FLAG_THREAD_CACHE);
+    expect_should_not_be(0, (u64)allocator);
+
+    lock_free_thread_data thread_args[NUM_THREADS];
+    zthread threads[NUM_THREADS];
+
+    for (i32 i = 0; i < NUM_THREADS; i++) {
+        thread_args[i].allocator = allocator;
+        thread_args[i].pattern = (u8)(i + 1);
+        thread_args[i].success = false;
+        if (!zthread_create(thread_pool_lock_free_alloc_free, &thread_args[i], &threads[i])) {
+            return false;
+        }
+    }
+
+    if (!zthread_wait_on_all(threads, NUM_THREADS)) {
+        return false;
+    }
+
+    for (i32 i = 0; i < NUM_THREADS; i++) {
+        if (!thread_args[i].success) {
+            return false;
+        }
+        zthread_destroy(&threads[i]);
+    }
+
+    // the exited threads drained their magazines to the depot, nothing may be lost
+    void* ptrs[ALLOCS_PER_THREAD * 4];
+    u64 count = 0;
+    while (count < chunk_count && (ptrs[count] = pool_allocator_allocate(allocator)) != 0) {
+        count++;
+    }
+    expect_should_be(chunk_count, count);
+    expect_should_be(0, (u64)pool_allocator_allocate(allocator));
+
+    // half of them end up in this thread's magazines
+    for (u64 i = 0; i < chunk_count / 2; i++) {
+        pool_allocator_free(allocator, ptrs[i]);
+    }
+
+    // after reset the cached rounds must not be handed out a second time
+    pool_allocator_reset(allocator);
+    count = 0;
+    while (count < chunk_count && (ptrs[count] = pool_allocator_allocate(allocator)) != 0) {
+        count++;
+    }
+    expect_should_be(chunk_count, count);
+    expect_should_be(0, (u64)pool_allocator_allocate(allocator));
+
+    pool_allocator_destroy(allocator);
+    return true;
+}
+
+// Thread scaling benchmark
+#define SCALING_MAX_THREADS 8
+#define SCALING_ITERATIONS 20000
+#define SCALING_BURST 16
+
+typedef struct {
+    pool_allocator* allocator;
+    u32 success;
+} scaling_thread_data;
+
+#ifdef WINDOWS
+u32 thread_pool_scaling(void* arg) {
+#else
+void* thread_pool_scaling(void* arg) {
+#endif
+    scaling_thread_data* data = (scaling_thread_data*)arg;
+    void* ptrs[SCALING_BURST];
+
+    for (i32 i = 0; i < SCALING_ITERATIONS; i++) {
+        for (i32 j = 0; j < SCALING_BURST; j++) {
+            ptrs[j] = pool_allocator_allocate(data->allocator);
+            if (!ptrs[j]) {
+                data->success = false;
+                return 0;
+            }
+        }
+        for (i32 j = 0; j < SCALING_BURST; j++) {
+            pool_allocator_free(data->allocator, ptrs[j]);
+        }
+    }
+
+    data->success = true;
+    return 0;
+}
+
+f64 pool_scaling_run(pool_allocator_flags flags, u32 thread_count) {
+    pool_allocator* allocator = pool_allocator_create_with_flags(64 * SCALING_BURST * SCALING_MAX_THREADS, 64, flags);
+    scaling_thread_data thread_args[SCALING_MAX_THREADS];
+    zthread threads[SCALING_MAX_THREADS];
+    clock bench_clock;
+
+    clock_set(&bench_clock);
+    for (u32 i = 0; i < thread_count; i++) {
+        thread_args[i].allocator = allocator;
+        thread_args[i].success = false;
+        if (!zthread_create(thread_pool_scaling, &thread_args[i], &threads[i])) {
+            return 0;
+        }
+    }
+    zthread_wait_on_all(threads, thread_count);
+    clock_update(&bench_clock);
+
+    for (u32 i = 0; i < thread_count; i++) {
+        zthread_destroy(&threads[i]);
+        if (!thread_args[i].success) {
+            pool_allocator_destroy(allocator);
+            return 0;
+        }
+    }
+    pool_allocator_destroy(allocator);
+
+    f64 ops = (f64)thread_count * SCALING_ITERATIONS * SCALING_BURST * 2;
+    return ops / bench_clock.elapsed;
+}
+
+u32 test_pool_allocator_scaling_benchmark() {
+    for (u32 thread_count = 1; thread_count <= SCALING_MAX_THREADS; thread_count <<= 1) {
+        f64 mutex_ops = pool_scaling_run(POOL_ALLOCATOR_FLAG_NONE, thread_count);
+        f64 lock_free_ops = pool_scaling_run(POOL_ALLOCATOR_FLAG_LOCK_FREE, thread_count);
+        f64 magazine_ops = pool_scaling_run(POOL_ALLOCATOR_FLAG_LOCK_FREE | POOL_ALLOCATOR_FLAG_THREAD_CACHE, thread_count);
+        if (mutex_ops == 0 || lock_free_ops == 0 || magazine_ops == 0) {
+            return false;
+        }
+        LOGT("threads = %u : mutex = %.0f ops/s , lock free = %.0f ops/s , magazines = %.0f ops/s",
+             thread_count, mutex_ops, lock_free_ops, magazine_ops);
+    }
+    return true;
+}
+
 // Benchmark tests
 u32 test_pool_allocator_benchmark() {
     clock bench_clock;
@@ -229,6 +1171,9 @@ u32 test_pool_allocator_benchmark() {
 
     // Test different chunk sizes
     const u64 chunk_sizes[] = {32, 64, 128, 256};
+    const i32 batch_size = 64;
+    const pool_allocator_flags batch_modes[] = {POOL_ALLOCATOR_FLAG_NONE, POOL_ALLOCATOR_FLAG_LOCK_FREE};
+    const char* batch_mode_names[] = {"mutex", "lock free"};
 
     for (u64 i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
         pool_allocator* allocator = pool_allocator_create(chunk_sizes[i] * num_allocs, chunk_sizes[i]);
@@ -253,6 +1198,32 @@ u32 test_pool_allocator_benchmark() {
         LOGT("Deallocation time for %d blocks of size %llu: %f seconds",
              num_allocs, chunk_sizes[i], bench_clock.elapsed);
 
+        // Benchmark batched allocation/deallocation, one lock round trip per batch
+        for (u64 b = 0; b < sizeof(batch_modes) / sizeof(batch_modes[0]); b++) {
+            pool_allocator* batch_allocator = pool_allocator_create_with_flags(chunk_sizes[i] * num_allocs, chunk_sizes[i], batch_modes[b]);
+
+            clock_set(&bench_clock);
+            for (i32 j = 0; j < num_allocs; j += batch_size) {
+                u64 count = (u64)(num_allocs - j < batch_size ? num_allocs - j : batch_size);
+                if (pool_allocator_allocate_batch(batch_allocator, ptrs + j, count) != count)
+                    return false;
+            }
+            clock_update(&bench_clock);
+            LOGT("Batched (%d) allocation time for %d blocks of size %llu (%s): %f seconds",
+                 batch_size, num_allocs, chunk_sizes[i], batch_mode_names[b], bench_clock.elapsed);
+
+            clock_set(&bench_clock);
+            for (i32 j = 0; j < num_allocs; j += batch_size) {
+                u64 count = (u64)(num_allocs - j < batch_size ? num_allocs - j : batch_size);
+                pool_allocator_free_batch(batch_allocator, ptrs + j, count);
+            }
+            clock_update(&bench_clock);
+            LOGT("Batched (%d) deallocation time for %d blocks of size %llu (%s): %f seconds",
+                 batch_size, num_allocs, chunk_sizes[i], batch_mode_names[b], bench_clock.elapsed);
+
+            pool_allocator_destroy(batch_allocator);
+        }
+
         pool_allocator_destroy(allocator);
     }
 
@@ -267,6 +1238,24 @@ void testing_pool_allocator() {
     test_manager_register_test(test_pool_allocator_full_allocation, "test_pool_allocator_full_allocation");
     test_manager_register_test(test_pool_allocator_edge_cases, "test_pool_allocator_edge_cases");
     test_manager_register_test(test_pool_allocator_reset, "test_pool_allocator_reset");
+    test_manager_register_test(test_pool_allocator_lazy_carving, "test_pool_allocator_lazy_carving");
+    test_manager_register_test(test_pool_allocator_no_header, "test_pool_allocator_no_header");
+    test_manager_register_test(test_pool_allocator_growable, "test_pool_allocator_growable");
+    test_manager_register_test(test_pool_allocator_batch, "test_pool_allocator_batch");
+    test_manager_register_test(test_pool_allocator_in_place, "test_pool_allocator_in_place");
+    test_manager_register_test(test_pool_allocator_for_each_live, "test_pool_allocator_for_each_live");
+    test_manager_register_test(test_pool_allocator_iteration_benchmark, "test_pool_allocator_iteration_benchmark");
+    test_manager_register_test(test_pool_allocator_handles, "test_pool_allocator_handles");
+    test_manager_register_test(test_pool_allocator_cache_color, "test_pool_allocator_cache_color");
+    test_manager_register_test(test_pool_allocator_cache_color_benchmark, "test_pool_allocator_cache_color_benchmark");
+    test_manager_register_test(test_pool_allocator_page_aligned, "test_pool_allocator_page_aligned");
+#ifdef LINUX
+    test_manager_register_test(test_pool_allocator_direct_io_benchmark, "test_pool_allocator_direct_io_benchmark");
+#endif
     test_manager_register_test(test_pool_allocator_multithreaded, "test_pool_allocator_multithreaded");
+    test_manager_register_test(test_pool_allocator_lock_free_multithreaded, "test_pool_allocator_lock_free_multithreaded");
+    test_manager_register_test(test_pool_allocator_handle_free_race, "test_pool_allocator_handle_free_race");
+    test_manager_register_test(test_pool_allocator_thread_cache, "test_pool_allocator_thread_cache");
     test_manager_register_test(test_pool_allocator_benchmark, "test_pool_allocator_benchmark");
+    test_manager_register_test(test_pool_allocator_scaling_benchmark, "test_pool_allocator_scaling_benchmark");
 }
\ No newline at end of file
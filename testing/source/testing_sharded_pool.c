@@ -0,0 +1,312 @@
+#include "testing_sharded_pool.h"
+#include "zthread.h"
+#include "zatomic.h"
+#include "expect.h"
+#include "test_manager.h"
+#include "zmemory.h"
+#include "platform.h"
+#include "clock.h"
+#include "logger.h"
+#include "sharded_pool.h"
+#include "pool_allocator.h"
+
+u32 test_sharded_pool_create_destroy() {
+    sharded_pool* pool = sharded_pool_create(4, 64 * 1024, 64);
+    expect_should_not_be(0, (u64)pool);
+    sharded_pool_destroy(pool);
+
+    expect_should_be(0, (u64)sharded_pool_create(0, 4096, 64));
+    expect_should_be(0, (u64)sharded_pool_create(4, 4096, 16));
+    expect_should_be(0, (u64)sharded_pool_create(4, 4096, 36));
+    expect_should_be(0, (u64)sharded_pool_create(4, 0, 64));
+    return true;
+}
+
+u32 test_sharded_pool_alloc_free() {
+    // one page shard of 64 byte chunks
+    const u64 chunk_count = platform_page_size() / 64;
+    void* ptrs[1024];
+    if (chunk_count > 1024) {
+        LOGW("test_sharded_pool_alloc_free : pages larger than 64 KiB are not covered");
+        return TEST_SKIPPED;
+    }
+    sharded_pool* pool = sharded_pool_create(1, 1, 64);
+
+    for (u64 i = 0; i < chunk_count; i++) {
+        ptrs[i] = sharded_pool_allocate(pool);
+        expect_should_not_be(0, (u64)ptrs[i]);
+        zmemory_set(ptrs[i], (u8)i, 64 - 16);
+    }
+    expect_should_be(0, (u64)sharded_pool_allocate(pool));
+    for (u64 i = 0; i < chunk_count; i++) {
+        expect_should_be((u8)i, *(u8*)ptrs[i]);
+    }
+
+    u64 outside;
+    sharded_pool_free(pool, &outside);
+    sharded_pool_free(pool, (u8*)ptrs[0] + 8);
+
+    sharded_pool_free(pool, ptrs[5]);
+    expect_should_be((u64)ptrs[5], (u64)sharded_pool_allocate(pool));
+
+    // the second free of a block is turned away, the pool is full so a second copy on the list would show up here
+    sharded_pool_free(pool, ptrs[6]);
+    sharded_pool_free(pool, ptrs[6]);
+    void* first = sharded_pool_allocate(pool);
+    void* second = sharded_pool_allocate(pool);
+    expect_should_be((u64)ptrs[6], (u64)first);
+    expect_should_be(0, (u64)second);
+
+    sharded_pool_reset(pool);
+    expect_should_be((u64)ptrs[0], (u64)sharded_pool_allocate(pool));
+
+    sharded_pool_destroy(pool);
+    return true;
+}
+
+typedef struct sharded_thread_data {
+    sharded_pool* pool;
+    void** ptrs;
+    u64 count;
+    u64 allocated;
+    bool detach;
+} sharded_thread_data;
+
+#ifdef WINDOWS
+u32 thread_sharded_pool_allocate(void* arg) {
+#else
+void* thread_sharded_pool_allocate(void* arg) {
+#endif
+    sharded_thread_data* data = (sharded_thread_data*)arg;
+    data->allocated = 0;
+    while (data->allocated < data->count && (data->ptrs[data->allocated] = sharded_pool_allocate(data->pool)) != 0) {
+        data->allocated++;
+    }
+    if (data->detach) {
+        sharded_pool_detach(data->pool);
+    }
+    return 0;
+}
+
+u32 test_sharded_pool_remote_free() {
+    const u64 chunk_count = platform_page_size() / 64;
+    void* ptrs[1024];
+    if (chunk_count > 1024) {
+        LOGW("test_sharded_pool_remote_free : pages larger than 64 KiB are not covered");
+        return TEST_SKIPPED;
+    }
+    sharded_pool* pool = sharded_pool_create(2, 1, 64);
+
+    // this thread claims the first shard, so every free of a worker chunk below is a remote free
+    void* own = sharded_pool_allocate(pool);
+    expect_should_not_be(0, (u64)own);
+
+    // a worker fills the other shard and hands it back before it exits
+    sharded_thread_data data = {pool, ptrs, chunk_count, 0, true};
+    zthread thread;
+    if (!zthread_create(thread_sharded_pool_allocate, &data, &thread) || !zthread_wait(&thread)) {
+        return false;
+    }
+    zthread_destroy(&thread);
+    expect_should_be(chunk_count, data.allocated);
+
+    for (u64 i = 0; i < chunk_count; i++) {
+        sharded_pool_free(pool, ptrs[i]);
+    }
+
+    // the next worker adopts the detached shard and drains its remote list on the first miss
+    if (!zthread_create(thread_sharded_pool_allocate, &data, &thread) || !zthread_wait(&thread)) {
+        return false;
+    }
+    zthread_destroy(&thread);
+    expect_should_be(chunk_count, data.allocated);
+
+    // chunks of the own shard go straight back on the local list
+    sharded_pool_free(pool, own);
+    expect_should_be((u64)own, (u64)sharded_pool_allocate(pool));
+
+    sharded_pool_destroy(pool);
+    return true;
+}
+
+#define SHARDED_EXIT_CHUNKS 16
+#define SHARDED_EVICT_POOLS 9
+
+// zthread exit hands the shard back on its own, no sharded_pool_detach anywhere
+u32 test_sharded_pool_thread_exit() {
+    sharded_pool* pool = sharded_pool_create(1, 1, 64);
+    void* ptrs[SHARDED_EXIT_CHUNKS];
+    sharded_thread_data data = {pool, ptrs, SHARDED_EXIT_CHUNKS, 0, false};
+    zthread thread;
+    if (!zthread_create(thread_sharded_pool_allocate, &data, &thread) || !zthread_wait(&thread)) {
+        return false;
+    }
+    zthread_destroy(&thread);
+    expect_should_be(SHARDED_EXIT_CHUNKS, data.allocated);
+    for (u64 i = 0; i < SHARDED_EXIT_CHUNKS; i++) {
+        sharded_pool_free(pool, ptrs[i]);
+    }
+
+    // the only shard is free again, the next worker adopts it and gets the remote frees back first
+    void* first = ptrs[SHARDED_EXIT_CHUNKS - 1];
+    if (!zthread_create(thread_sharded_pool_allocate, &data, &thread) || !zthread_wait(&thread)) {
+        return false;
+    }
+    zthread_destroy(&thread);
+    expect_should_be(SHARDED_EXIT_CHUNKS, data.allocated);
+    expect_should_be((u64)first, (u64)ptrs[0]);
+
+    sharded_pool_destroy(pool);
+    return true;
+}
+
+typedef struct sharded_evict_data {
+    sharded_pool** pools;
+    u64 adopted;
+} sharded_evict_data;
+
+#ifdef WINDOWS
+u32 thread_sharded_pool_adopt(void* arg) {
+#else
+void* thread_sharded_pool_adopt(void* arg) {
+#endif
+    sharded_evict_data* data = (sharded_evict_data*)arg;
+    data->adopted = 0;
+    for (u32 i = 0; i < SHARDED_EVICT_POOLS; i++) {
+        data->adopted += sharded_pool_allocate(data->pools[i]) != 0;
+    }
+    return 0;
+}
+
+// one more pool than a thread has slots for, the shard that lost its slot must be claimable by others
+u32 test_sharded_pool_slot_eviction() {
+    sharded_pool* pools[SHARDED_EVICT_POOLS];
+    for (u32 i = 0; i < SHARDED_EVICT_POOLS; i++) {
+        pools[i] = sharded_pool_create(1, 1, 64);
+        expect_should_not_be(0, (u64)sharded_pool_allocate(pools[i]));
+    }
+
+    sharded_evict_data data = {pools, 0};
+    zthread thread;
+    if (!zthread_create(thread_sharded_pool_adopt, &data, &thread) || !zthread_wait(&thread)) {
+        return false;
+    }
+    zthread_destroy(&thread);
+    expect_should_be(1, data.adopted);
+
+    for (u32 i = 0; i < SHARDED_EVICT_POOLS; i++) {
+        sharded_pool_destroy(pools[i]);
+    }
+    return true;
+}
+
+// single producer single consumer ring, the producer allocates and the consumer frees
+#define HANDOFF_RING_SIZE 4096
+#define HANDOFF_ITEMS 200000
+
+typedef struct handoff_ring {
+    void* slots[HANDOFF_RING_SIZE];
+    u64 head; // written by the producer
+    u64 tail; // written by the consumer
+    pool_allocator* allocator;
+    sharded_pool* pool;
+    bool success;
+} handoff_ring;
+
+#ifdef WINDOWS
+u32 thread_handoff_consumer(void* arg) {
+#else
+void* thread_handoff_consumer(void* arg) {
+#endif
+    handoff_ring* ring = (handoff_ring*)arg;
+    for (u64 tail = 0; tail < HANDOFF_ITEMS; tail++) {
+        while (zatomic_load(&ring->head) == tail) {
+            platform_sleep(0);
+        }
+        void* block = ring->slots[tail % HANDOFF_RING_SIZE];
+        if (ring->pool) {
+            sharded_pool_free(ring->pool, block);
+        } else {
+            pool_allocator_free(ring->allocator, block);
+        }
+        zatomic_store(&ring->tail, tail + 1);
+    }
+    return 0;
+}
+
+#ifdef WINDOWS
+u32 thread_handoff_producer(void* arg) {
+#else
+void* thread_handoff_producer(void* arg) {
+#endif
+    handoff_ring* ring = (handoff_ring*)arg;
+    for (u64 head = 0; head < HANDOFF_ITEMS; head++) {
+        while (head - zatomic_load(&ring->tail) == HANDOFF_RING_SIZE) {
+            platform_sleep(0);
+        }
+        void* block = ring->pool ? sharded_pool_allocate(ring->pool) : pool_allocator_allocate(ring->allocator);
+        if (block == 0) {
+            ring->success = false;
+            break;
+        }
+        ring->slots[head % HANDOFF_RING_SIZE] = block;
+        zatomic_store(&ring->head, head + 1);
+    }
+    if (ring->pool) {
+        sharded_pool_detach(ring->pool);
+    }
+    return 0;
+}
+
+bool run_handoff(handoff_ring* ring) {
+    ring->head = 0;
+    ring->tail = 0;
+    ring->success = true;
+    zthread threads[2];
+    if (!zthread_create(thread_handoff_consumer, ring, &threads[0]) ||
+        !zthread_create(thread_handoff_producer, ring, &threads[1])) {
+        return false;
+    }
+    if (!zthread_wait_on_all(threads, 2)) {
+        return false;
+    }
+    zthread_destroy(&threads[0]);
+    zthread_destroy(&threads[1]);
+    return ring->success;
+}
+
+u32 test_sharded_pool_producer_consumer_benchmark() {
+    clock bench_clock;
+    handoff_ring* ring = zmemory_allocate(sizeof(handoff_ring));
+
+    // room for a full ring plus the chunks still on their way home
+    ring->allocator = pool_allocator_create(64 * HANDOFF_RING_SIZE * 4, 64);
+    ring->pool = 0;
+    clock_set(&bench_clock);
+    bool mutex_ok = run_handoff(ring);
+    clock_update(&bench_clock);
+    LOGT("pool_allocator : %d items handed from producer to consumer: %f seconds", HANDOFF_ITEMS, bench_clock.elapsed);
+    pool_allocator_destroy(ring->allocator);
+
+    ring->allocator = 0;
+    ring->pool = sharded_pool_create(2, 64 * HANDOFF_RING_SIZE * 4, 64);
+    clock_set(&bench_clock);
+    bool sharded_ok = run_handoff(ring);
+    clock_update(&bench_clock);
+    LOGT("sharded_pool : %d items handed from producer to consumer: %f seconds", HANDOFF_ITEMS, bench_clock.elapsed);
+    sharded_pool_destroy(ring->pool);
+
+    zmemory_free(ring, sizeof(handoff_ring));
+    expect_should_be(true, mutex_ok);
+    expect_should_be(true, sharded_ok);
+    return true;
+}
+
+void testing_sharded_pool() {
+    test_manager_register_test(test_sharded_pool_create_destroy, "test_sharded_pool_create_destroy");
+    test_manager_register_test(test_sharded_pool_alloc_free, "test_sharded_pool_alloc_free");
+    test_manager_register_test(test_sharded_pool_remote_free, "test_sharded_pool_remote_free");
+    test_manager_register_test(test_sharded_pool_thread_exit, "test_sharded_pool_thread_exit");
+    test_manager_register_test(test_sharded_pool_slot_eviction, "test_sharded_pool_slot_eviction");
+    test_manager_register_test(test_sharded_pool_producer_consumer_benchmark, "test_sharded_pool_producer_consumer_benchmark");
+}
@@ -0,0 +1,6 @@
+#ifndef TESTING_SHARDED_POOL__H
+#define TESTING_SHARDED_POOL__H
+
+void testing_sharded_pool();
+
+#endif
@@ -0,0 +1,180 @@
+#include "testing_sizeclass_allocator.h"
+#include "expect.h"
+#include "test_manager.h"
+#include "zmemory.h"
+#include "utils.h"
+#include "clock.h"
+#include "logger.h"
+#include "sizeclass_allocator.h"
+#include "freelist_allocator.h"
+
+u32 test_sizeclass_allocator_create_destroy() {
+    sizeclass_allocator* allocator = sizeclass_allocator_create(64 * 1024);
+    expect_should_not_be(0, (u64)allocator);
+    sizeclass_allocator_destroy(allocator);
+
+    expect_should_be(0, (u64)sizeclass_allocator_create(0));
+    return true;
+}
+
+u32 test_sizeclass_allocator_class_table() {
+    // every request lands on the smallest class that holds it
+    for (u64 size = 1; size <= SIZECLASS_MAX_SIZE; size++) {
+        u32 class_index = sizeclass_allocator_class_index(size);
+        if (class_index >= SIZECLASS_COUNT) {
+            return false;
+        }
+        if (sizeclass_allocator_class_size(class_index) < size) {
+            LOGE("class %u too small for %llu", class_index, size);
+            return false;
+        }
+        if (class_index > 0 && sizeclass_allocator_class_size(class_index - 1) >= size) {
+            LOGE("class %u not the smallest for %llu", class_index, size);
+            return false;
+        }
+    }
+    expect_should_be(SIZECLASS_COUNT, sizeclass_allocator_class_index(SIZECLASS_MAX_SIZE + 1));
+    expect_should_be(48ull, sizeclass_allocator_class_size(sizeclass_allocator_class_index(33)));
+    expect_should_be(320ull, sizeclass_allocator_class_size(sizeclass_allocator_class_index(257)));
+    return true;
+}
+
+u32 test_sizeclass_allocator_alloc_free() {
+    sizeclass_allocator* allocator = sizeclass_allocator_create(64 * 1024);
+    const u64 sizes[] = {1, 8, 9, 24, 33, 100, 129, 200, 500, 1000, 1024, 3000, 4096};
+    void* ptrs[sizeof(sizes) / sizeof(sizes[0])];
+
+    for (u64 i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        ptrs[i] = sizeclass_allocator_allocate(allocator, sizes[i]);
+        expect_should_not_be(0, (u64)ptrs[i]);
+        u64 usable = sizeclass_allocator_usable_size(allocator, ptrs[i]);
+        expect_should_be(sizeclass_allocator_class_size(sizeclass_allocator_class_index(sizes[i])), usable);
+        zmemory_set(ptrs[i], (u8)i, usable);
+    }
+    for (u64 i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        u8* bytes = ptrs[i];
+        for (u64 j = 0; j < sizes[i]; j++) {
+            if (bytes[j] != (u8)i)
+                return false;
+        }
+    }
+
+    // frees find their class from the address alone, so the same chunk comes straight back
+    for (u64 i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        sizeclass_allocator_free(allocator, ptrs[i]);
+        void* again = sizeclass_allocator_allocate(allocator, sizes[i]);
+        expect_should_be((u64)ptrs[i], (u64)again);
+        sizeclass_allocator_free(allocator, again);
+    }
+
+    sizeclass_allocator_destroy(allocator);
+    return true;
+}
+
+u32 test_sizeclass_allocator_invalid() {
+    sizeclass_allocator* allocator = sizeclass_allocator_create(64 * 1024);
+
+    expect_should_be(0, (u64)sizeclass_allocator_allocate(allocator, 0));
+    expect_should_be(0, (u64)sizeclass_allocator_allocate(allocator, SIZECLASS_MAX_SIZE + 1));
+
+    u64 outside;
+    sizeclass_allocator_free(allocator, &outside);
+    expect_should_be(0ull, sizeclass_allocator_usable_size(allocator, &outside));
+
+    // misaligned and double frees are caught by the class pool
+    u8* ptr = sizeclass_allocator_allocate(allocator, 48);
+    sizeclass_allocator_free(allocator, ptr + 8);
+    sizeclass_allocator_free(allocator, ptr);
+    sizeclass_allocator_free(allocator, ptr);
+    expect_should_be((u64)ptr, (u64)sizeclass_allocator_allocate(allocator, 48));
+    expect_should_not_be((u64)ptr, (u64)sizeclass_allocator_allocate(allocator, 48));
+
+    sizeclass_allocator_destroy(allocator);
+    return true;
+}
+
+u32 test_sizeclass_allocator_exhaustion_reset() {
+    // a single page per class, the 4096 class holds exactly one chunk
+    sizeclass_allocator* allocator = sizeclass_allocator_create(1);
+
+    void* big = sizeclass_allocator_allocate(allocator, SIZECLASS_MAX_SIZE);
+    expect_should_not_be(0, (u64)big);
+    expect_should_be(0, (u64)sizeclass_allocator_allocate(allocator, SIZECLASS_MAX_SIZE));
+
+    // other classes are unaffected
+    expect_should_not_be(0, (u64)sizeclass_allocator_allocate(allocator, 64));
+
+    sizeclass_allocator_reset(allocator);
+    expect_should_be((u64)big, (u64)sizeclass_allocator_allocate(allocator, SIZECLASS_MAX_SIZE));
+
+    sizeclass_allocator_destroy(allocator);
+    return true;
+}
+
+u32 test_sizeclass_allocator_benchmark() {
+    clock bench_clock;
+    const i32 num_allocs = 5000;
+    void* ptrs[5000];
+    u64 sizes[5000];
+    for (i32 i = 0; i < num_allocs; i++) {
+        sizes[i] = ((u64)i * 37) % 1024 + 1;
+    }
+
+    // the second pass runs on warm pages and recycled chunks
+    sizeclass_allocator* allocator = sizeclass_allocator_create(1024 * 1024);
+    for (i32 pass = 0; pass < 2; pass++) {
+        clock_set(&bench_clock);
+        for (i32 i = 0; i < num_allocs; i++) {
+            ptrs[i] = sizeclass_allocator_allocate(allocator, sizes[i]);
+            if (!ptrs[i])
+                return false;
+        }
+        clock_update(&bench_clock);
+        LOGT("sizeclass : pass %d allocation time for %d mixed blocks under 1KiB: %f seconds", pass, num_allocs, bench_clock.elapsed);
+
+        clock_set(&bench_clock);
+        for (i32 i = 0; i < num_allocs; i += 2) {
+            sizeclass_allocator_free(allocator, ptrs[i]);
+        }
+        for (i32 i = 1; i < num_allocs; i += 2) {
+            sizeclass_allocator_free(allocator, ptrs[i]);
+        }
+        clock_update(&bench_clock);
+        LOGT("sizeclass : pass %d deallocation time for %d mixed blocks under 1KiB: %f seconds", pass, num_allocs, bench_clock.elapsed);
+    }
+    sizeclass_allocator_destroy(allocator);
+
+    freelist_allocator* freelist = freelist_allocator_create(8 * 1024 * 1024);
+    for (i32 pass = 0; pass < 2; pass++) {
+        clock_set(&bench_clock);
+        for (i32 i = 0; i < num_allocs; i++) {
+            ptrs[i] = freelist_allocator_allocate(freelist, sizes[i]);
+            if (!ptrs[i])
+                return false;
+        }
+        clock_update(&bench_clock);
+        LOGT("freelist : pass %d allocation time for %d mixed blocks under 1KiB: %f seconds", pass, num_allocs, bench_clock.elapsed);
+
+        clock_set(&bench_clock);
+        for (i32 i = 0; i < num_allocs; i += 2) {
+            freelist_allocator_free(freelist, ptrs[i]);
+        }
+        for (i32 i = 1; i < num_allocs; i += 2) {
+            freelist_allocator_free(freelist, ptrs[i]);
+        }
+        clock_update(&bench_clock);
+        LOGT("freelist : pass %d deallocation time for %d mixed blocks under 1KiB: %f seconds", pass, num_allocs, bench_clock.elapsed);
+    }
+    freelist_allocator_destroy(freelist);
+
+    return true;
+}
+
+void testing_sizeclass_allocator() {
+    test_manager_register_test(test_sizeclass_allocator_create_destroy, "test_sizeclass_allocator_create_destroy");
+    test_manager_register_test(test_sizeclass_allocator_class_table, "test_sizeclass_allocator_class_table");
+    test_manager_register_test(test_sizeclass_allocator_alloc_free, "test_sizeclass_allocator_alloc_free");
+    test_manager_register_test(test_sizeclass_allocator_invalid, "test_sizeclass_allocator_invalid");
+    test_manager_register_test(test_sizeclass_allocator_exhaustion_reset, "test_sizeclass_allocator_exhaustion_reset");
+    test_manager_register_test(test_sizeclass_allocator_benchmark, "test_sizeclass_allocator_benchmark");
+}
@@ -0,0 +1,6 @@
+#ifndef TESTING_SIZECLASS_ALLOCATOR__H
+#define TESTING_SIZECLASS_ALLOCATOR__H
+
+void testing_sizeclass_allocator();
+
+#endif